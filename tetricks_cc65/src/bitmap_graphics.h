@@ -39,8 +39,107 @@ uint16_t canvas_width(void);
 uint16_t canvas_height(void);
 uint8_t bits_per_pixel(void);
 
+// Drawing contexts: a bitmap_canvas holds everything drawing on a canvas
+// depends on, its plane, bpp, clip rectangle and text settings, along with
+// the plot() kernel and color tables worked out for its bpp. Everything below
+// draws with the context in use, which starts as the default one
+// init_bitmap_graphics() sets up, so a program with one canvas never needs
+// any of this. init_bitmap_plane() sets up another on a plane of its own,
+// shown at x, y, and uses it; use_canvas() switches by copying the one in
+// use out and c in, with nothing to work out again. current_canvas() gives
+// the one in use, brought up to date. Queued drawing lands on the canvas that
+// was in use when it was queued.
+typedef struct {
+    uint16_t struct_addr;
+    uint16_t data;
+    uint8_t  plane;
+    uint8_t  bpp_mode;
+    uint16_t w, h;
+    uint16_t stride;
+    uint16_t bytes;
+    int16_t  x, y; // where it's shown
+    uint16_t palette;
+    int16_t  clip_x0, clip_y0, clip_x1, clip_y1;
+    uint16_t cursor_x, cursor_y;
+    uint16_t textcolor, textbgcolor;
+    uint8_t  textmultiplier;
+    bool     text_wrap;
+    bool     opaque_black;
+    void   (*plot)(uint16_t color, uint16_t x, uint16_t y);
+    uint16_t color_lut[16];
+    uint8_t  color_patterns[16];
+} bitmap_canvas;
+void init_bitmap_plane(bitmap_canvas * c,
+                       uint16_t canvas_struct_address,
+                       uint16_t canvas_data_address,
+                       uint8_t  canvas_plane,
+                       int16_t  x,
+                       int16_t  y,
+                       uint16_t canvas_width,
+                       uint16_t canvas_height,
+                       uint8_t  bits_per_pixel);
+void use_canvas(bitmap_canvas * c);
+bitmap_canvas * current_canvas(void);
+// A wrapped canvas repeats across the screen, so moving it scrolls.
+void set_canvas_wrap(bool x_wrap, bool y_wrap);
+void move_canvas(int16_t x, int16_t y);
+
 uint16_t random(uint16_t low_limit, uint16_t high_limit);
 
+// bitmap_graphics keeps track of what RIA.addr0 and RIA.step0 hold between
+// calls. Call xram_cursor_invalidate() after using XRAM portal 0 yourself.
+void xram_cursor_invalidate(void);
+void xram_cursor_flush(void);
+
+// Bulk XRAM moves, through the cursor. xram_copy() copies as memmove() does,
+// and uses XRAM portal 1 as well.
+void xram_fill(uint16_t addr, uint8_t val, uint16_t count);
+void xram_copy(uint16_t dst, uint16_t src, uint16_t count);
+
+// Everything below draws only inside the clip rectangle, the whole canvas
+// until set otherwise. Coordinates a little off the left or top of it, from
+// wrapped uint16_t math say, get clipped too.
+void set_clip_rect(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+void reset_clip_rect(void);
+
+// Colors 0-15, BLACK to WHITE in colors.h, look the same whatever the bpp:
+// in 16bpp they're looked up in a table made by init_bitmap_graphics().
+// Other values are drawn as they are, as 8bpp palette indices or 16bpp
+// pixels from color_from_rgb5().
+void set_opaque_black(bool opaque);
+
+// Custom palettes: set_palette() copies count rgb5 colors (with the alpha
+// bit) into XRAM at addr, and use_palette() points the canvas at one, or at
+// the built-in palette with 0xFFFF. The first PALETTE_COLORS entries of the
+// palette set_palette() set up last can be animated without redrawing
+// anything, while the canvas is using it: a flash holds color for frames then
+// goes back, a pulse fades there and back, a fade stays, and a cycle rotates
+// count entries one along every frames frames. Each keeps to that palette
+// whichever canvas is in use later, and stopping puts the colors back as set.
+// Call animate_palette() once per vsync; it returns true while any are going.
+#define PALETTE_COLORS 16
+#define PALETTE_ANIMS  4
+void set_palette(uint16_t addr, const uint16_t * colors, uint16_t count);
+void use_palette(uint16_t addr);
+void set_palette_color(uint8_t index, uint16_t color);
+void flash_palette(uint8_t index, uint16_t color, uint8_t frames);
+void pulse_palette(uint8_t index, uint16_t color, uint8_t frames);
+void fade_palette(uint8_t index, uint16_t color, uint8_t frames);
+void cycle_palette(uint8_t first, uint8_t count, uint8_t frames);
+void stop_palette_anims(void);
+bool animate_palette(void);
+
+// Screen shake: offset_canvas() shows the canvas moved from where it was put,
+// redrawing nothing. shake_canvas() rattles it dx, dy pixels either way,
+// dying down over frames; nudge_canvas() knocks it dx, dy over and lets it
+// spring back. Call animate_shake() once per vsync; it returns true while the
+// canvas is still moving, and puts it back where it was when it's done.
+void offset_canvas(int16_t dx, int16_t dy);
+void shake_canvas(int8_t dx, int8_t dy, uint8_t frames);
+void nudge_canvas(int8_t dx, int8_t dy, uint8_t frames);
+void stop_shake(void);
+bool animate_shake(void);
+
 void erase_canvas(void);
 void draw_pixel(uint16_t color, uint16_t x, uint16_t y);
 void draw_vline(uint16_t color, uint16_t x, uint16_t y, uint16_t h);
@@ -48,11 +147,70 @@ void draw_hline(uint16_t color, uint16_t x, uint16_t y, uint16_t w);
 void draw_line(uint16_t color, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
 void draw_rect(uint16_t color, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
 void fill_rect(uint16_t color, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+// Circles and rounded rects go a row of spans at a time, for radii up to 255.
 void draw_circle(uint16_t color, uint16_t x0, uint16_t y0, uint16_t r);
 void fill_circle(uint16_t color, uint16_t x0, uint16_t y0, uint16_t r);
 void draw_rounded_rect(uint16_t color, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t r);
 void fill_rounded_rect(uint16_t color, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t r);
 
+// Block stamps: a STAMP_SIZE square pattern in 4bpp pixels, with mask marking
+// the nibbles that take the stamp's color instead, like the outline of a
+// playfield cell. Work out stamp_address() once, say per cell of a grid.
+#define STAMP_SIZE  8
+#define STAMP_BYTES (STAMP_SIZE*STAMP_SIZE/2)
+typedef struct {
+    uint8_t base[STAMP_BYTES];
+    uint8_t mask[STAMP_BYTES];
+} stamp;
+uint16_t stamp_address(uint16_t x, uint16_t y);
+void draw_stamp(const stamp * s, uint16_t color, uint16_t addr);
+
+// Compiled sprites: generated code that writes its bytes through XRAM portal
+// 0 at fixed offsets from addr, and expects RIA.step0 to be 1.
+typedef void (*sprite_fn)(uint16_t addr);
+void draw_sprite(sprite_fn fn, uint16_t addr);
+
+// RAM shadow: init_shadow() copies w x h pixels of the 4bpp canvas in use
+// from x, y into buf, SHADOW_BYTES(w, h) of RAM, and from then on anything
+// drawn there on that canvas goes into buf instead, with no XRAM reads. Rows
+// that change are marked dirty, and flush_shadow() writes them out to XRAM,
+// stopping once budget bytes are spent, and returns how many are left.
+// end_shadow() flushes the lot and stops shadowing. There's one at a time,
+// and compiled sprites and xram_ calls go straight to XRAM past it.
+#define SHADOW_ROWS 240 // most rows a shadow can have
+#define SHADOW_BYTES(w, h) (((w)/2 + 1) * (h))
+bool init_shadow(uint8_t * buf, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+void end_shadow(void);
+uint16_t flush_shadow(uint16_t budget);
+uint16_t shadow_size(void);
+uint16_t shadow_dirty_rows(void);
+bool shadow_row_dirty(uint16_t y);
+
+// Deferred drawing: the queue_ functions record a primitive instead of
+// drawing it, and flush_draw_queue() draws them, best called right after the
+// RIA.vsync edge. A queued primitive that exactly covers an earlier one (like
+// an erase followed by a draw of the same cell) supersedes it. Each flush
+// stops at the per-frame byte budget, and the rest carries over. Nothing is
+// drawn while queuing: with no room left for a command, or for a string's
+// text, the queue_ function returns false without queuing it, and it can be
+// tried again after the next flush. A command for another canvas than the
+// one before it takes two of the DRAW_QUEUE_LEN slots.
+#define DRAW_QUEUE_LEN  32 // max commands waiting
+#define DRAW_QUEUE_TEXT 64 // max characters of queued strings waiting
+#define DRAW_BUDGET    512 // default XRAM bytes per flush
+void set_draw_budget(uint16_t bytes);
+bool queue_block(uint16_t color, uint16_t x, uint16_t y, uint16_t size);
+bool queue_rect(uint16_t color, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+bool queue_fill_rect(uint16_t color, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+bool queue_span(uint16_t color, uint16_t x, uint16_t y, uint16_t w);
+bool queue_stamp(const stamp * s, uint16_t color, uint16_t addr);
+bool queue_sprite(sprite_fn fn, uint16_t addr, uint16_t bytes);
+bool queue_string(uint16_t x, uint16_t y, const char * str);
+uint8_t flush_draw_queue(void);
+void finish_draw_queue(void);
+uint8_t draw_queue_length(void);
+uint8_t draw_queue_room(void);
+
 void set_cursor(uint16_t x, uint16_t y);
 void set_text_multiplier(uint8_t mult);
 void set_text_color(uint16_t color); // transparent background
@@ -61,4 +219,62 @@ void set_text_wrap(bool w);
 void draw_char(char chr, uint16_t x, uint16_t y);
 void draw_string(char * str);
 
+// Each primitive on context c: these switch to it for the one call, then
+// back to the canvas that was in use. For a run of drawing on one canvas,
+// use_canvas() it once instead. leave_canvas() passes the call's result on.
+// They nest, CANVAS_ON_DEPTH deep, as when one's an argument of another.
+#define CANVAS_ON_DEPTH 4
+void enter_canvas(bitmap_canvas * c);
+uint16_t leave_canvas(uint16_t result);
+#define erase_canvas_on(c) \
+    (enter_canvas(c), erase_canvas(), leave_canvas(0))
+#define set_clip_rect_on(c, x, y, w, h) \
+    (enter_canvas(c), set_clip_rect(x, y, w, h), leave_canvas(0))
+#define reset_clip_rect_on(c) \
+    (enter_canvas(c), reset_clip_rect(), leave_canvas(0))
+#define draw_pixel_on(c, color, x, y) \
+    (enter_canvas(c), draw_pixel(color, x, y), leave_canvas(0))
+#define draw_vline_on(c, color, x, y, h) \
+    (enter_canvas(c), draw_vline(color, x, y, h), leave_canvas(0))
+#define draw_hline_on(c, color, x, y, w) \
+    (enter_canvas(c), draw_hline(color, x, y, w), leave_canvas(0))
+#define draw_line_on(c, color, x0, y0, x1, y1) \
+    (enter_canvas(c), draw_line(color, x0, y0, x1, y1), leave_canvas(0))
+#define draw_rect_on(c, color, x, y, w, h) \
+    (enter_canvas(c), draw_rect(color, x, y, w, h), leave_canvas(0))
+#define fill_rect_on(c, color, x, y, w, h) \
+    (enter_canvas(c), fill_rect(color, x, y, w, h), leave_canvas(0))
+#define draw_circle_on(c, color, x0, y0, r) \
+    (enter_canvas(c), draw_circle(color, x0, y0, r), leave_canvas(0))
+#define fill_circle_on(c, color, x0, y0, r) \
+    (enter_canvas(c), fill_circle(color, x0, y0, r), leave_canvas(0))
+#define draw_rounded_rect_on(c, color, x, y, w, h, r) \
+    (enter_canvas(c), draw_rounded_rect(color, x, y, w, h, r), leave_canvas(0))
+#define fill_rounded_rect_on(c, color, x, y, w, h, r) \
+    (enter_canvas(c), fill_rounded_rect(color, x, y, w, h, r), leave_canvas(0))
+#define stamp_address_on(c, x, y) \
+    (enter_canvas(c), leave_canvas(stamp_address(x, y)))
+#define draw_stamp_on(c, s, color, addr) \
+    (enter_canvas(c), draw_stamp(s, color, addr), leave_canvas(0))
+#define draw_sprite_on(c, fn, addr) \
+    (enter_canvas(c), draw_sprite(fn, addr), leave_canvas(0))
+#define queue_block_on(c, color, x, y, size) \
+    (enter_canvas(c), (bool)leave_canvas(queue_block(color, x, y, size)))
+#define queue_rect_on(c, color, x, y, w, h) \
+    (enter_canvas(c), (bool)leave_canvas(queue_rect(color, x, y, w, h)))
+#define queue_fill_rect_on(c, color, x, y, w, h) \
+    (enter_canvas(c), (bool)leave_canvas(queue_fill_rect(color, x, y, w, h)))
+#define queue_span_on(c, color, x, y, w) \
+    (enter_canvas(c), (bool)leave_canvas(queue_span(color, x, y, w)))
+#define queue_stamp_on(c, s, color, addr) \
+    (enter_canvas(c), (bool)leave_canvas(queue_stamp(s, color, addr)))
+#define queue_sprite_on(c, fn, addr, bytes) \
+    (enter_canvas(c), (bool)leave_canvas(queue_sprite(fn, addr, bytes)))
+#define queue_string_on(c, x, y, str) \
+    (enter_canvas(c), (bool)leave_canvas(queue_string(x, y, str)))
+#define draw_char_on(c, chr, x, y) \
+    (enter_canvas(c), draw_char(chr, x, y), leave_canvas(0))
+#define draw_string_on(c, str) \
+    (enter_canvas(c), draw_string(str), leave_canvas(0))
+
 #endif // BITMAP_GRAPHICS_H
@@ -0,0 +1,469 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/canvas.c
+//
+// This library was written by tonyvr to simplify bitmap graphics programming
+// of the RP6502 picocomputer designed by Rumbledethumps.
+//
+// This code is an adaptation of the vga_graphics library written by V. Hunter Adams
+// from Cornell University, for his excellent RP2040 microcontroller programming course.
+//
+// https://github.com/vha3/Hunter-Adams-RP2040-Demos/tree/master/VGA_Graphics/VGA_Graphics_Primitives
+//
+// There doesn't seem to be a copyright or a license associated with his code.
+// I don't care what you do with my version either -- have fun!
+//
+// The canvas itself: setting up the bitmap mode, and what it ended up as.
+// ---------------------------------------------------------------------------
+
+#include <rp6502.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "bg_internal.h"
+
+static uint16_t canvas_struct = 0xFF00;
+static uint8_t  plane = 0;
+static uint8_t  canvas_mode = 2;
+uint16_t        canvas_data = 0x0000;
+uint16_t        canvas_w = 320;
+uint16_t        canvas_h = 180;
+uint8_t         bpp_mode = 3;
+uint16_t        canvas_bytes = 57600;
+uint16_t        palette_ptr = 0xFFFF;
+static int16_t  canvas_x = 0; // where the canvas was put on screen
+static int16_t  canvas_y = 0;
+bitmap_canvas   default_canvas;
+bitmap_canvas * active_canvas = &default_canvas;
+static bitmap_canvas * canvas_before_on[CANVAS_ON_DEPTH]; // what *_on() calls go back to
+static uint8_t         canvas_on_depth = 0;
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+uint8_t bpp_mode_to_bpp[] = {1, 2, 4, 8, 16};
+static uint8_t bbp_to_bpp_mode(uint8_t bpp)
+{
+    switch(bpp) {
+        case 1:  return 0;
+        case 2:  return 1;
+        case 4:  return 2;
+        case 8:  return 3;
+        case 16: return 4;
+    }
+    return 2; // default
+}
+
+// ---------------------------------------------------------------------------
+// Work out what follows from the canvas settings.
+// ---------------------------------------------------------------------------
+static void canvas_changed(void)
+{
+    xram_stride = canvas_w * bpp_mode_to_bpp[bpp_mode] / 8;
+    canvas_bytes = xram_stride * canvas_h;
+    init_kernels();
+    reset_clip_rect();
+}
+
+// ---------------------------------------------------------------------------
+// Fill in the canvas's vga_mode3_config_t, and show it on its plane at x, y.
+// ---------------------------------------------------------------------------
+static void setup_plane(int16_t x, int16_t y)
+{
+    xram0_struct_set(canvas_struct, vga_mode3_config_t, x_wrap, false);
+    xram0_struct_set(canvas_struct, vga_mode3_config_t, y_wrap, false);
+    xram0_struct_set(canvas_struct, vga_mode3_config_t, x_pos_px, x);
+    xram0_struct_set(canvas_struct, vga_mode3_config_t, y_pos_px, y);
+    canvas_x = x;
+    canvas_y = y;
+    xram0_struct_set(canvas_struct, vga_mode3_config_t, width_px, canvas_w);
+    xram0_struct_set(canvas_struct, vga_mode3_config_t, height_px, canvas_h);
+    xram0_struct_set(canvas_struct, vga_mode3_config_t, xram_data_ptr, canvas_data);
+    xram0_struct_set(canvas_struct, vga_mode3_config_t, xram_palette_ptr, 0xFFFF);
+    palette_ptr = 0xFFFF;
+
+    xram_cursor_invalidate(); // we just moved RIA.addr0 behind its back
+
+    // initialize the bitmap video modes
+    xreg_vga_mode(3, bpp_mode, canvas_struct, plane); // bitmap mode
+    //xregn(1, 0, 1, 4, 3, bpp_mode, canvas_struct, plane);
+}
+
+// ---------------------------------------------------------------------------
+// Copy the settings of the canvas being drawn on that can change after it's
+// set up out to *c. That's all use_canvas() has to put away.
+// ---------------------------------------------------------------------------
+static void store_settings(bitmap_canvas * c)
+{
+    c->x = canvas_x;
+    c->y = canvas_y;
+    c->palette = palette_ptr;
+    c->clip_x0 = clip_x0;
+    c->clip_y0 = clip_y0;
+    c->clip_x1 = clip_x1;
+    c->clip_y1 = clip_y1;
+    c->cursor_x = cursor_x;
+    c->cursor_y = cursor_y;
+    c->textcolor = textcolor;
+    c->textbgcolor = textbgcolor;
+    c->textmultiplier = textmultiplier;
+    c->text_wrap = text_wrap;
+    c->opaque_black = opaque_black;
+    c->plot = plot;
+}
+
+// ---------------------------------------------------------------------------
+// Copy all the settings of the canvas being drawn on out to *c, once it's
+// set up. The color tables are already there: init_kernels() keeps them.
+// ---------------------------------------------------------------------------
+static void store_canvas(bitmap_canvas * c)
+{
+    c->struct_addr = canvas_struct;
+    c->data = canvas_data;
+    c->plane = plane;
+    c->bpp_mode = bpp_mode;
+    c->w = canvas_w;
+    c->h = canvas_h;
+    c->stride = xram_stride;
+    c->bytes = canvas_bytes;
+    store_settings(c);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void init_bitmap_graphics(uint16_t canvas_struct_address,
+                          uint16_t canvas_data_address,
+                          uint8_t  canvas_plane,
+                          uint8_t  canvas_type,
+                          uint16_t canvas_width,
+                          uint16_t canvas_height,
+                          uint8_t  bits_per_pixel)
+{
+    uint8_t x_offset = 0;
+    uint8_t y_offset = 0;
+
+    // defaults
+    active_canvas = &default_canvas;
+    shadow_canvas = 0; // it was on a canvas that's gone
+    canvas_struct = 0xFF00;
+    canvas_data = 0x0000;
+    plane = 0;
+    canvas_mode = 2;
+    canvas_w = 320;
+    canvas_h = 180;
+    bpp_mode = 3;
+
+    // valid range check
+    if (canvas_struct_address != 0) {
+        canvas_struct = canvas_struct_address;
+    }
+    if (canvas_data_address != 0) {
+        canvas_data = canvas_data_address;
+    }
+    if (/*canvas_plane >= 0 &&*/ canvas_plane <= 2) {
+        plane = canvas_plane;
+    }
+    if (canvas_type > 0 && canvas_type <= 4) {
+        canvas_mode = canvas_type;
+    }
+    if (canvas_width > 0 && canvas_width <= 640) {
+        canvas_w = canvas_width;
+    }
+    if (canvas_height > 0 && canvas_height <= 480) {
+        canvas_h = canvas_height;
+    }
+    if (bits_per_pixel == 1 ||
+        bits_per_pixel == 2 ||
+        bits_per_pixel == 4 ||
+        bits_per_pixel == 8 ||
+        bits_per_pixel == 16  ) {
+        bpp_mode = bbp_to_bpp_mode(bits_per_pixel);
+    }
+
+    // additional contraints (due to memory limit of 64K)
+    if (bpp_mode_to_bpp[bpp_mode] == 16) { // bits color
+        canvas_mode = 2;
+        canvas_w = 240; // max for 16-bit color
+        canvas_h = 124; // max for 16-bit color
+    } else if (bpp_mode_to_bpp[bpp_mode] == 8) { // bits color
+        canvas_mode = 2;
+        canvas_w = 320; // max for 8-bit color
+        canvas_h = 180; // max for 8-bit color
+    } else if (bpp_mode_to_bpp[bpp_mode] == 4) { // bits color
+        canvas_w = 320; // max for 4-bit color
+        if (canvas_mode > 2) {
+            canvas_mode = 1;
+            canvas_h = 240; // max for 4-bit color
+        } else if (canvas_mode == 2) {
+            canvas_h = 180; // max for canvas_mode 2
+        }
+    } else if (bpp_mode_to_bpp[bpp_mode] == 2) { // bits color
+        if (canvas_mode == 4) {
+            canvas_h = 360; // max for canvas_mode 4
+        }
+    }
+
+    canvas_changed();
+
+    // center canvas if necessary
+    if (bpp_mode_to_bpp[bpp_mode] == 16) {
+        x_offset = 30; // (360 - 240)/4
+        y_offset = 29; // (240 - 124)/4
+    }
+
+    if (canvas_struct_address != canvas_struct) {
+        printf("Asked for canvas_struct_address of 0x%04X, but got 0x%04X\n", canvas_struct_address, canvas_struct);
+    }
+    if (canvas_data_address != canvas_data) {
+        printf("Asked for canvas_data_address of 0x%04X, but got 0x%04X\n", canvas_struct_address, canvas_data);
+    }
+    if (canvas_type != canvas_mode) {
+        printf("Asked for canvas_type of %u, but got %u\n", canvas_type, canvas_mode);
+    }
+    if (canvas_width != canvas_w) {
+        printf("Asked for canvas_width of %u, but got %u\n", canvas_width, canvas_w);
+    }
+    if (canvas_height != canvas_h) {
+        printf("Asked for canvas_height of %u, but got %u\n", canvas_height, canvas_h);
+    }
+    if (bits_per_pixel != bpp_mode_to_bpp[bpp_mode]) {
+        printf("Asked for bits_per_pixel of %u, but got %u\n", bits_per_pixel, bpp_mode_to_bpp[bpp_mode]);
+    }
+
+    // initialize the canvas
+    xreg_vga_canvas(canvas_mode);
+    //xregn(1, 0, 0, 1, canvas_mode);
+
+    setup_plane(x_offset, y_offset);
+    store_canvas(&default_canvas);
+
+    //xreg_vga_mode(0, 1); // console
+}
+
+// ---------------------------------------------------------------------------
+// Another canvas, on a plane of its own, shown at x, y, with its settings
+// kept in *c. The screen stays in the canvas_type init_bitmap_graphics()
+// chose, so this can be any size that fits in XRAM from canvas_data_address
+// on. Drawing goes to it from here on, with the text settings as they start
+// out; use_canvas(current_canvas()) beforehand gets back to the one before.
+// ---------------------------------------------------------------------------
+void init_bitmap_plane(bitmap_canvas * c,
+                       uint16_t canvas_struct_address,
+                       uint16_t canvas_data_address,
+                       uint8_t  canvas_plane,
+                       int16_t  x,
+                       int16_t  y,
+                       uint16_t canvas_width,
+                       uint16_t canvas_height,
+                       uint8_t  bits_per_pixel)
+{
+    uint16_t stride;
+
+    store_settings(active_canvas); // whatever was in use is left as it was
+    canvas_struct = canvas_struct_address;
+    canvas_data = canvas_data_address;
+    plane = (canvas_plane <= 2) ? canvas_plane : 1;
+    bpp_mode = bbp_to_bpp_mode(bits_per_pixel);
+    canvas_w = (canvas_width > 0 && canvas_width <= 640) ? canvas_width : 320;
+    canvas_h = (canvas_height > 0) ? canvas_height : 1;
+
+    // it has to fit in what's left of the 64K
+    stride = canvas_w * bpp_mode_to_bpp[bpp_mode] / 8;
+    if ((uint32_t)stride * canvas_h > 0xFFFFU - canvas_data) {
+        canvas_h = (0xFFFFU - canvas_data) / stride;
+    }
+    if (canvas_height != canvas_h) {
+        printf("Asked for canvas_height of %u, but got %u\n", canvas_height, canvas_h);
+    }
+    if (bits_per_pixel != bpp_mode_to_bpp[bpp_mode]) {
+        printf("Asked for bits_per_pixel of %u, but got %u\n", bits_per_pixel, bpp_mode_to_bpp[bpp_mode]);
+    }
+
+    cursor_x = cursor_y = 0;
+    textcolor = textbgcolor = 15;
+    textmultiplier = 1;
+    text_wrap = true;
+    opaque_black = false;
+    active_canvas = c;
+    canvas_changed();
+    setup_plane(x, y);
+    store_canvas(c);
+}
+
+// ---------------------------------------------------------------------------
+// Draw on c from now on. The settings of the one being left that can have
+// changed, like its clip rectangle or text cursor, are copied out first, to
+// come back to. Its kernel and color tables come along with the rest, but
+// the tables only follow from the bpp and opaque black, so they're only
+// copied in when those differ.
+// ---------------------------------------------------------------------------
+void use_canvas(bitmap_canvas * c)
+{
+    if (c == active_canvas) {
+        return;
+    }
+    store_settings(active_canvas);
+    if (c->bpp_mode != bpp_mode || c->opaque_black != opaque_black) {
+        memcpy(color_lut, c->color_lut, sizeof(color_lut));
+        memcpy(color_patterns, c->color_patterns, sizeof(color_patterns));
+    }
+    canvas_struct = c->struct_addr;
+    canvas_data = c->data;
+    plane = c->plane;
+    bpp_mode = c->bpp_mode;
+    canvas_w = c->w;
+    canvas_h = c->h;
+    xram_stride = c->stride;
+    canvas_bytes = c->bytes;
+    canvas_x = c->x;
+    canvas_y = c->y;
+    palette_ptr = c->palette;
+    clip_x0 = c->clip_x0;
+    clip_y0 = c->clip_y0;
+    clip_x1 = c->clip_x1;
+    clip_y1 = c->clip_y1;
+    cursor_x = c->cursor_x;
+    cursor_y = c->cursor_y;
+    textcolor = c->textcolor;
+    textbgcolor = c->textbgcolor;
+    textmultiplier = c->textmultiplier;
+    text_wrap = c->text_wrap;
+    opaque_black = c->opaque_black;
+    plot = c->plot;
+    active_canvas = c;
+}
+
+// ---------------------------------------------------------------------------
+// The canvas being drawn on, the default one unless use_canvas() or
+// init_bitmap_plane() said otherwise. Its settings are copied out first, so
+// they can be read from it.
+// ---------------------------------------------------------------------------
+bitmap_canvas * current_canvas(void)
+{
+    store_settings(active_canvas);
+    return active_canvas;
+}
+
+// ---------------------------------------------------------------------------
+// What the *_on() macros wrap a call in: enter_canvas() switches to c for
+// it, and leave_canvas() switches back and hands on what the call returned.
+// The call goes in between, as leave_canvas()'s argument if it returns
+// something. The canvases to go back to are kept as a stack, so an *_on()
+// call in the arguments of another goes back to the right one. Past
+// CANVAS_ON_DEPTH deep the innermost ones just stay on c, and the one
+// outside them goes back.
+// ---------------------------------------------------------------------------
+void enter_canvas(bitmap_canvas * c)
+{
+    if (canvas_on_depth < CANVAS_ON_DEPTH) {
+        canvas_before_on[canvas_on_depth] = active_canvas;
+    }
+    canvas_on_depth++;
+    use_canvas(c);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+uint16_t leave_canvas(uint16_t result)
+{
+    if (canvas_on_depth > 0 && --canvas_on_depth < CANVAS_ON_DEPTH) {
+        use_canvas(canvas_before_on[canvas_on_depth]);
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Let the canvas repeat across the screen, so that moving it scrolls it
+// round. The flags are the first two bytes of its vga_mode3_config_t.
+// ---------------------------------------------------------------------------
+void set_canvas_wrap(bool x_wrap, bool y_wrap)
+{
+    RIA.step1 = 1;
+    RIA.addr1 = canvas_struct + offsetof(vga_mode3_config_t, x_wrap);
+    RIA.rw1 = x_wrap;
+    RIA.rw1 = y_wrap;
+}
+
+// ---------------------------------------------------------------------------
+// Show the canvas at x, y from now on, which offset_canvas() then goes from.
+// ---------------------------------------------------------------------------
+void move_canvas(int16_t x, int16_t y)
+{
+    canvas_x = x;
+    canvas_y = y;
+    offset_canvas(0, 0);
+}
+
+// ---------------------------------------------------------------------------
+// Point the canvas at the palette at addr in XRAM, 0xFFFF for the built-in.
+// ---------------------------------------------------------------------------
+void use_palette(uint16_t addr)
+{
+    xram_cursor_flush();
+    xram0_struct_set(canvas_struct, vga_mode3_config_t, xram_palette_ptr, addr);
+    xram_cursor_invalidate();
+    palette_ptr = addr;
+}
+
+// ---------------------------------------------------------------------------
+// Show the canvas dx, dy pixels away from where it was put, without touching
+// what's drawn on it. x_pos_px and y_pos_px sit next to each other, so that's
+// four bytes through portal 1, which leaves the XRAM cursor alone.
+// ---------------------------------------------------------------------------
+void offset_canvas(int16_t dx, int16_t dy)
+{
+    int16_t x = canvas_x + dx;
+    int16_t y = canvas_y + dy;
+
+    RIA.step1 = 1;
+    RIA.addr1 = canvas_struct + offsetof(vga_mode3_config_t, x_pos_px);
+    RIA.rw1 = x & 0xFF;
+    RIA.rw1 = x >> 8;
+    RIA.rw1 = y & 0xFF;
+    RIA.rw1 = y >> 8;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+uint16_t canvas_width(void)
+{
+    return canvas_w;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+uint16_t canvas_height(void)
+{
+    return canvas_h;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+uint8_t bits_per_pixel(void)
+{
+    return bpp_mode_to_bpp[bpp_mode];
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void erase_canvas(void)
+{
+    uint16_t num_bytes;
+
+    if (bpp_mode == 4) { // 16bpp
+        num_bytes = (canvas_w<<1) * canvas_h;
+    } else if (bpp_mode == 3) { // 8bpp
+        num_bytes = canvas_w * canvas_h;
+    } else if (bpp_mode == 2) { // 4bpp
+        num_bytes = (canvas_w>>1) * canvas_h;
+    } else if (bpp_mode == 1) { //2bpp
+        num_bytes = (canvas_w>>2) * canvas_h;
+    } else if (bpp_mode == 0) { //1bpp
+        num_bytes = (canvas_w>>3) * canvas_h;
+    }
+
+    xram_fill(canvas_data, 0, num_bytes);
+    if (SHADOWED()) {
+        shadow->erase();
+    }
+}
@@ -0,0 +1,164 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/circle.c
+//
+// Circles and rounded rectangles.
+// Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bg_internal.h"
+
+// Radii up to CIRCLE_CACHE_MAX keep their row widths once worked out. Bigger
+// ones, up to CIRCLE_RADIUS_MAX, share a table holding the last one drawn.
+#define CIRCLE_CACHE_MAX  15
+#define CIRCLE_RADIUS_MAX 255
+
+static uint8_t  circle_cache[(CIRCLE_CACHE_MAX+1)*(CIRCLE_CACHE_MAX+2)/2];
+static uint16_t circle_cached = 0; // bit r set once circle_cache holds radius r
+static uint8_t  circle_big[CIRCLE_RADIUS_MAX+1];
+static uint8_t  circle_big_r = 0;  // radius in circle_big, 0 if none
+
+// ---------------------------------------------------------------------------
+// Work out w[0..r] for a midpoint circle of radius r: d rows above or below
+// its center, the circle reaches w[d] pixels either side. Those rows are
+// exactly what the midpoint algorithm fills, just a row at a time.
+// ---------------------------------------------------------------------------
+static void circle_widths(uint8_t * w, uint8_t r)
+{
+    int16_t f     = 1 - r;
+    int16_t ddF_x = 1;
+    int16_t ddF_y = -2 * r;
+    uint8_t x     = 0;
+    uint8_t y     = r;
+    uint8_t d;
+
+    for (d = 0; d < r; d++) {
+        w[d] = 0;
+    }
+    w[r] = 0;
+
+    while (x<y) {
+        if (f >= 0) {
+            y--;
+            ddF_y += 2;
+            f     += ddF_y;
+        }
+
+        x++;
+        ddF_x += 2;
+        f     += ddF_x;
+
+        if (w[y] < x) { // column x reaches down to row y
+            w[y] = x;
+        }
+        if (w[x] < y) { // and column y to row x
+            w[x] = y;
+        }
+    }
+    for (d = r; d > 0; d--) { // a row is at least as wide as the one below
+        if (w[d-1] < w[d]) {
+            w[d-1] = w[d];
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// The row widths for radius r, from the cache if they're there.
+// ---------------------------------------------------------------------------
+static const uint8_t * circle_rows(uint8_t r)
+{
+    if (r <= CIRCLE_CACHE_MAX) {
+        uint8_t * w = circle_cache + r*(r+1)/2;
+        if (!(circle_cached & (1U << r))) {
+            circle_widths(w, r);
+            circle_cached |= 1U << r;
+        }
+        return w;
+    }
+    if (circle_big_r != r) {
+        circle_widths(circle_big, r);
+        circle_big_r = r;
+    }
+    return circle_big;
+}
+
+// ---------------------------------------------------------------------------
+// Outline or fill what a radius r circle sweeps out as its center goes from
+// (xl,yt) to (xr,yb): the circle itself when they're the same point, else a
+// rounded rect. It goes a row at a time, as horizontal spans, which sit in
+// consecutive XRAM bytes where a column doesn't. The outline is the one the
+// midpoint algorithm draws: at each row it runs from just past the next row
+// in towards the middle, out to this row's width. Only a shape across an edge
+// of the clip rectangle has its spans clipped.
+// ---------------------------------------------------------------------------
+static void draw_rounded(uint16_t color, uint16_t xl, uint16_t xr,
+                         uint16_t yt, uint16_t yb, uint16_t r, bool fill)
+{
+    const uint8_t * w;
+    void (*row_span)(uint16_t color, uint16_t x, uint16_t y, uint16_t w);
+    int16_t top, bottom, row;
+    uint8_t d, lo, clip;
+
+    if (r > CIRCLE_RADIUS_MAX) {
+        return;
+    }
+    top = (int16_t)yt - r;
+    bottom = (int16_t)yb + r;
+    clip = clip_box((int16_t)xl - r, top, (int16_t)xr + r, bottom);
+    if (clip == CLIP_OUT) {
+        return;
+    }
+    row_span = (clip == CLIP_IN) ? span : clip_span;
+    w = circle_rows(r);
+    d = r;
+    for (row = top; ; row++) {
+        uint8_t wd = w[d];
+        if (fill || row == top || row == bottom) {
+            row_span(color, xl - wd, row, xr - xl + 2*wd + 1);
+        } else {
+            lo = (d < r && w[d+1] < wd) ? w[d+1] + 1 : wd;
+            row_span(color, xl - wd, row, wd - lo + 1);
+            row_span(color, xr + lo, row, wd - lo + 1);
+        }
+        if (row == bottom) {
+            break;
+        }
+        if (row < (int16_t)yt) {
+            d--;
+        } else if (row >= (int16_t)yb) {
+            d++;
+        }
+    }
+    xram_cursor_flush();
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void draw_circle(uint16_t color, uint16_t x0, uint16_t y0, uint16_t r)
+{
+    draw_rounded(color, x0, x0, y0, y0, r, false);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void fill_circle(uint16_t color, uint16_t x0, uint16_t y0, uint16_t r)
+{
+    draw_rounded(color, x0, x0, y0, y0, r, true);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void draw_rounded_rect(uint16_t color,
+                       uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t r)
+{
+    draw_rounded(color, x+r, x+w-r-1, y+r, y+h-r-1, r, false);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void fill_rounded_rect(uint16_t color,
+                       uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t r)
+{
+    draw_rounded(color, x+r, x+w-r-1, y+r, y+h-r-1, r, true);
+}
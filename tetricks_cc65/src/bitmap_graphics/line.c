@@ -0,0 +1,265 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/line.c
+//
+// Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "bg_internal.h"
+
+// How a pixel steps sideways through XRAM in the current bpp mode, for the
+// packed loops. Pixels narrower than a byte move the mask along by line_bpp
+// bits, on to the next byte at the end. 8bpp pixels keep the mask at 0xFF,
+// so every step is on to the next byte. 16bpp has loops of its own.
+static uint8_t line_bpp;   // bits per pixel, up to 8
+static uint8_t line_first; // mask of the leftmost pixel in a byte
+static uint8_t line_last;  // mask of the rightmost pixel in a byte
+static uint8_t line_pat;   // the color in every pixel of a byte
+static uint8_t line_hi;    // high byte of the color, for 16bpp
+
+// ---------------------------------------------------------------------------
+// A line mostly along x, 1-8bpp, going right from addr/mask for dx+1
+// pixels, and stepping ystep bytes (a row up or down) every time the error
+// runs out.
+// ---------------------------------------------------------------------------
+static void line_shallow(uint16_t addr, uint8_t mask,
+                         int16_t dx, int16_t dy, int16_t ystep)
+{
+    int16_t err = dx / 2;
+    int16_t n;
+
+    for (n = dx; n >= 0; n--) {
+        xram_plot(addr, line_pat & mask, mask);
+        if (mask == line_last) {
+            mask = line_first;
+            addr++;
+        } else {
+            mask >>= line_bpp;
+        }
+        err -= dy;
+        if (err < 0) {
+            addr += ystep;
+            err += dx;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// line_shallow() in 16bpp, two whole bytes a pixel.
+// ---------------------------------------------------------------------------
+static void line_shallow_16(uint16_t addr, int16_t dx, int16_t dy, int16_t ystep)
+{
+    int16_t err = dx / 2;
+    int16_t n;
+
+    for (n = dx; n >= 0; n--) {
+        xram_plot(addr, line_pat, 0xFF);
+        xram_plot(addr+1, line_hi, 0xFF);
+        addr += 2;
+        err -= dy;
+        if (err < 0) {
+            addr += ystep;
+            err += dx;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// A line mostly along y, 1-8bpp, going down from addr/mask for dy+1 pixels,
+// and stepping a pixel right every time the error runs out.
+// ---------------------------------------------------------------------------
+static void line_steep_right(uint16_t addr, uint8_t mask, int16_t dy, int16_t dx)
+{
+    int16_t err = dy / 2;
+    int16_t n;
+
+    for (n = dy; n >= 0; n--) {
+        xram_plot(addr, line_pat & mask, mask);
+        addr += xram_stride;
+        err -= dx;
+        if (err < 0) {
+            if (mask == line_last) {
+                mask = line_first;
+                addr++;
+            } else {
+                mask >>= line_bpp;
+            }
+            err += dy;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// line_steep_right(), stepping a pixel left instead.
+// ---------------------------------------------------------------------------
+static void line_steep_left(uint16_t addr, uint8_t mask, int16_t dy, int16_t dx)
+{
+    int16_t err = dy / 2;
+    int16_t n;
+
+    for (n = dy; n >= 0; n--) {
+        xram_plot(addr, line_pat & mask, mask);
+        addr += xram_stride;
+        err -= dx;
+        if (err < 0) {
+            if (mask == line_first) {
+                mask = line_last;
+                addr--;
+            } else {
+                mask <<= line_bpp;
+            }
+            err += dy;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// A steep line in 16bpp, stepping xstep bytes, a pixel left or right, every
+// time the error runs out.
+// ---------------------------------------------------------------------------
+static void line_steep_16(uint16_t addr, int16_t dy, int16_t dx, int8_t xstep)
+{
+    int16_t err = dy / 2;
+    int16_t n;
+
+    for (n = dy; n >= 0; n--) {
+        xram_plot(addr, line_pat, 0xFF);
+        xram_plot(addr+1, line_hi, 0xFF);
+        addr += xram_stride;
+        err -= dx;
+        if (err < 0) {
+            addr += xstep;
+            err += dy;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// The same steps as the loops above, but a plot() per pixel,
+// for a line through the RAM shadow. It goes major+1 pixels from x, y along
+// the major axis, and a pixel step along the other when the error runs out.
+// ---------------------------------------------------------------------------
+static void line_plot(uint16_t color, uint16_t x, uint16_t y,
+                      int16_t major, int16_t minor, bool steep, int8_t step)
+{
+    int16_t err = major / 2;
+    int16_t n;
+
+    for (n = major; n >= 0; n--) {
+        plot(color, x, y);
+        if (steep) {
+            y++;
+        } else {
+            x++;
+        }
+        err -= minor;
+        if (err < 0) {
+            if (steep) {
+                x += step;
+            } else {
+                y += step;
+            }
+            err += major;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Draw a straight line from (x0,y0) to (x1,y1) with given color
+// using Bresenham's algorithm. It's clipped first, so the loops below can
+// skip checking each pixel. Lines along the axes go to draw_hline() and
+// draw_vline(). The others are drawn from the end with the lower x (or the
+// lower y when steep), which leaves shallow, steep left and steep right to
+// cover all eight octants, each with a loop for 1-8bpp and one for 16bpp
+// (which steps either way by a signed byte count). These step the XRAM
+// address and mask along instead of working them out again for every
+// pixel, and don't test the mode or direction inside the loop. Through the
+// RAM shadow, it's plotted instead.
+// ---------------------------------------------------------------------------
+void draw_line(uint16_t color, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    int16_t dx, dy;
+    uint16_t addr;
+    uint8_t mask;
+    uint8_t bpp = bpp_mode_to_bpp[bpp_mode];
+    int16_t cx0 = x0, cy0 = y0, cx1 = x1, cy1 = y1;
+    bool shadowed;
+
+    if (!clip_line(&cx0, &cy0, &cx1, &cy1)) {
+        return;
+    }
+    x0 = cx0;
+    y0 = cy0;
+    x1 = cx1;
+    y1 = cy1;
+
+    if (y0 == y1) {
+        if (x0 > x1) {
+            swap(x0, x1);
+        }
+        draw_hline(color, x0, y0, x1 - x0 + 1);
+        return;
+    }
+    if (x0 == x1) {
+        if (y0 > y1) {
+            swap(y0, y1);
+        }
+        draw_vline(color, x0, y0, y1 - y0 + 1);
+        return;
+    }
+
+    shadowed = shadow_touches((x0 < x1) ? x0 : x1, (y0 < y1) ? y0 : y1,
+                              (x0 < x1) ? x1 : x0, (y0 < y1) ? y1 : y0);
+
+    if (bpp < 8) {
+        line_bpp = bpp;
+        line_first = 0xFF << (8 - bpp);
+        line_last = 0xFF >> (8 - bpp);
+    } else {
+        line_bpp = 8;
+        line_first = line_last = 0xFF;
+    }
+    line_pat = color_pattern(color);
+    line_hi = color_value(color) >> 8;
+
+    dx = abs((int16_t)x1 - (int16_t)x0);
+    dy = abs((int16_t)y1 - (int16_t)y0);
+
+    if (dy > dx) {
+        if (y0 > y1) {
+            swap(x0, x1);
+            swap(y0, y1);
+        }
+        if (shadowed) {
+            line_plot(color, x0, y0, dy, dx, true, (x1 < x0) ? -1 : 1);
+        } else {
+            addr = pixel_addr(x0, y0, &mask);
+            if (bpp == 16) {
+                line_steep_16(addr, dy, dx, (x1 < x0) ? -2 : 2);
+            } else if (x1 < x0) {
+                line_steep_left(addr, mask, dy, dx);
+            } else {
+                line_steep_right(addr, mask, dy, dx);
+            }
+        }
+    } else {
+        if (x0 > x1) {
+            swap(x0, x1);
+            swap(y0, y1);
+        }
+        if (shadowed) {
+            line_plot(color, x0, y0, dx, dy, false, (y1 < y0) ? -1 : 1);
+        } else {
+            int16_t ystep = (y1 < y0) ? -xram_stride : xram_stride;
+            addr = pixel_addr(x0, y0, &mask);
+            if (bpp == 16) {
+                line_shallow_16(addr, dx, dy, ystep);
+            } else {
+                line_shallow(addr, mask, dx, dy, ystep);
+            }
+        }
+    }
+    xram_cursor_flush();
+}
@@ -0,0 +1,420 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/queue.c
+//
+// The draw queue. Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bg_internal.h"
+
+// ---------------------------------------------------------------------------
+// Deferred drawing
+// ---------------------------------------------------------------------------
+typedef enum {DRAW_NONE, DRAW_BLOCK, DRAW_RECT, DRAW_FILL, DRAW_SPAN, DRAW_STRING, DRAW_STAMP,
+              DRAW_SPRITE, DRAW_CANVAS} draw_type;
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  mult;    // text multiplier, for DRAW_STRING
+    uint8_t  bpp;     // bpp_mode of the canvas it draws on, for its cost
+    uint16_t color;
+    uint16_t bgcolor; // text background, for DRAW_STRING
+    uint16_t x, y, w, h;  // x is the XRAM address for DRAW_STAMP and DRAW_SPRITE,
+                          // and w the bytes a DRAW_SPRITE writes
+    uint8_t  text;    // offset into draw_text, for DRAW_STRING
+    uint8_t  len;     // characters at draw_text+text, for DRAW_STRING
+    const stamp * pattern; // for DRAW_STAMP
+    sprite_fn sprite;      // for DRAW_SPRITE
+    bitmap_canvas * canvas; // for DRAW_CANVAS, what the commands after it draw on
+} draw_cmd;
+
+static draw_cmd draw_queue[DRAW_QUEUE_LEN];
+static uint8_t  queue_head = 0; // next command to draw
+static uint8_t  queue_tail = 0; // next free slot
+static char     draw_text[DRAW_QUEUE_TEXT];
+static uint8_t  text_used = 0;
+static uint16_t draw_budget = DRAW_BUDGET;
+static bitmap_canvas * queued_canvas = &default_canvas; // what the last command queued draws on
+static bitmap_canvas * flush_canvas = &default_canvas;  // and the next one to be drawn
+
+// ---------------------------------------------------------------------------
+// Rough count of XRAM bytes a command touches, which is a pixel per byte
+// for the read-modify-write modes, or two bytes per pixel in 16bpp. Costed
+// at the bpp of the canvas it was queued for, not the one in use now.
+// ---------------------------------------------------------------------------
+static uint16_t draw_cmd_cost(const draw_cmd *c)
+{
+    uint16_t pixels;
+    switch (c->type) {
+        case DRAW_BLOCK:
+        case DRAW_RECT:
+            pixels = 2*(c->w + c->h);
+            break;
+        case DRAW_FILL:
+        case DRAW_STRING:
+            if (c->w == 0) {
+                return 0;
+            }
+            pixels = (c->h > 0x7FFF/c->w) ? 0x7FFF : c->w * c->h;
+            break;
+        case DRAW_SPAN:
+            pixels = c->w;
+            break;
+        case DRAW_STAMP:
+            if (c->bpp == 2) {
+                return STAMP_BYTES; // whole bytes, no reads
+            }
+            pixels = STAMP_SIZE*STAMP_SIZE;
+            break;
+        case DRAW_SPRITE:
+            return c->w;
+        default:
+            return 0;
+    }
+    return (c->bpp == 4) ? pixels<<1 : pixels;
+}
+
+// ---------------------------------------------------------------------------
+// True if drawing n overwrites every pixel c would have drawn.
+// ---------------------------------------------------------------------------
+static bool draw_cmd_covers(const draw_cmd *n, const draw_cmd *c)
+{
+    if (n->type == DRAW_STAMP || c->type == DRAW_STAMP) { // placed by address
+        return (n->type == c->type) && (n->x == c->x);
+    }
+    if (n->type == DRAW_SPRITE || c->type == DRAW_SPRITE) { // only by itself
+        return (n->type == c->type) && (n->x == c->x) && (n->sprite == c->sprite);
+    }
+    if (n->type == DRAW_FILL) {
+        return (c->x >= n->x) && (c->x + c->w <= n->x + n->w) &&
+               (c->y >= n->y) && (c->y + c->h <= n->y + n->h);
+    }
+    if (n->type != c->type || n->x != c->x || n->y != c->y ||
+        n->w != c->w || n->h != c->h) {
+        return false;
+    }
+    if (n->type == DRAW_STRING) { // only an opaque string hides the old one
+        return (n->bgcolor != n->color) && (n->len == c->len) && (n->mult == c->mult);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+static void run_draw_cmd(const draw_cmd *c)
+{
+    if (c->type == DRAW_CANVAS) {
+        flush_canvas = c->canvas;
+        return;
+    }
+    use_canvas(flush_canvas);
+    switch (c->type) {
+        case DRAW_BLOCK:
+        case DRAW_RECT:
+            draw_rect(c->color, c->x, c->y, c->w, c->h);
+            break;
+        case DRAW_FILL:
+            fill_rect(c->color, c->x, c->y, c->w, c->h);
+            break;
+        case DRAW_SPAN:
+            draw_hline(c->color, c->x, c->y, c->w);
+            break;
+        case DRAW_STAMP:
+            draw_stamp(c->pattern, c->color, c->x);
+            break;
+        case DRAW_SPRITE:
+            draw_sprite(c->sprite, c->x);
+            break;
+        case DRAW_STRING: {
+            // draw it with the text settings it was queued with
+            uint16_t old_x = cursor_x, old_y = cursor_y;
+            uint16_t old_color = textcolor, old_bgcolor = textbgcolor;
+            uint8_t old_mult = textmultiplier;
+            uint8_t i;
+            cursor_x = c->x;
+            cursor_y = c->y;
+            textcolor = c->color;
+            textbgcolor = c->bgcolor;
+            textmultiplier = c->mult;
+            for (i = 0; i < c->len; i++) {
+                draw_char_at_cursor(draw_text[c->text + i]);
+            }
+            xram_cursor_flush();
+            cursor_x = old_x;
+            cursor_y = old_y;
+            textcolor = old_color;
+            textbgcolor = old_bgcolor;
+            textmultiplier = old_mult;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Closes up the gaps superseded commands left, from queue_head on.
+// ---------------------------------------------------------------------------
+static void compact_draw_queue(void)
+{
+    uint8_t i, n = 0;
+
+    for (i = queue_head; i < queue_tail; i++) {
+        if (draw_queue[i].type != DRAW_NONE) {
+            draw_queue[n++] = draw_queue[i];
+        }
+    }
+    queue_head = 0;
+    queue_tail = n;
+}
+
+// ---------------------------------------------------------------------------
+// Adds a command, dropping anything queued earlier that it hides. A command
+// for another canvas than the last one goes in after a DRAW_CANVAS, and only
+// what's queued since the last of those can be hidden by it. If there isn't
+// room, nothing is queued or dropped, and it returns false.
+// ---------------------------------------------------------------------------
+static bool queue_draw_cmd(const draw_cmd *n)
+{
+    uint8_t i, first = queue_head;
+    uint8_t slots = (active_canvas != queued_canvas) ? 2 : 1;
+
+    if (queue_tail + slots > DRAW_QUEUE_LEN) {
+        compact_draw_queue();
+        if (queue_tail + slots > DRAW_QUEUE_LEN) {
+            return false; // try again after the next flush
+        }
+    }
+    if (slots == 2) {
+        draw_queue[queue_tail].type = DRAW_CANVAS;
+        draw_queue[queue_tail++].canvas = active_canvas;
+        queued_canvas = active_canvas;
+    } else {
+        for (i = queue_head; i < queue_tail; i++) {
+            if (draw_queue[i].type == DRAW_CANVAS) {
+                first = i + 1;
+            }
+        }
+        for (i = first; i < queue_tail; i++) {
+            if (draw_queue[i].type != DRAW_NONE && draw_cmd_covers(n, &draw_queue[i])) {
+                draw_queue[i].type = DRAW_NONE; // superseded
+            }
+        }
+    }
+    draw_queue[queue_tail] = *n;
+    draw_queue[queue_tail++].bpp = bpp_mode; // of active_canvas, which it draws on
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Frees the text of strings already drawn, moving what's still queued down
+// to the start of draw_text. Strings are queued in text order, so the first
+// one still queued holds the lowest offset.
+// ---------------------------------------------------------------------------
+static void compact_draw_text(void)
+{
+    uint8_t i, from = text_used;
+
+    for (i = queue_head; i < queue_tail; i++) {
+        if (draw_queue[i].type == DRAW_STRING) {
+            from = draw_queue[i].text;
+            break;
+        }
+    }
+    for (i = from; i < text_used; i++) {
+        draw_text[i - from] = draw_text[i];
+    }
+    for (i = queue_head; i < queue_tail; i++) {
+        if (draw_queue[i].type == DRAW_STRING) {
+            draw_queue[i].text -= from;
+        }
+    }
+    text_used -= from;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+static bool queue_shape(uint8_t type, uint16_t color,
+                        uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    draw_cmd c;
+    c.type = type;
+    c.color = color;
+    c.x = x;
+    c.y = y;
+    c.w = w;
+    c.h = h;
+    return queue_draw_cmd(&c);
+}
+
+// ---------------------------------------------------------------------------
+// Set the XRAM bytes flush_draw_queue() may spend per call
+// ---------------------------------------------------------------------------
+void set_draw_budget(uint16_t bytes)
+{
+    draw_budget = (bytes > 0) ? bytes : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Queue a square outline, like a playfield cell, to be drawn by draw_rect()
+// ---------------------------------------------------------------------------
+bool queue_block(uint16_t color, uint16_t x, uint16_t y, uint16_t size)
+{
+    return queue_shape(DRAW_BLOCK, color, x, y, size, size);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+bool queue_rect(uint16_t color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    return queue_shape(DRAW_RECT, color, x, y, w, h);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+bool queue_fill_rect(uint16_t color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    return queue_shape(DRAW_FILL, color, x, y, w, h);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+bool queue_span(uint16_t color, uint16_t x, uint16_t y, uint16_t w)
+{
+    return queue_shape(DRAW_SPAN, color, x, y, w, 1);
+}
+
+// ---------------------------------------------------------------------------
+// Queue a draw_stamp(). The pattern isn't copied, so it has to stay put.
+// ---------------------------------------------------------------------------
+bool queue_stamp(const stamp * s, uint16_t color, uint16_t addr)
+{
+    draw_cmd c;
+    c.type = DRAW_STAMP;
+    c.color = color;
+    c.x = addr;
+    c.pattern = s;
+    return queue_draw_cmd(&c);
+}
+
+// ---------------------------------------------------------------------------
+// Queue a draw_sprite(), counting it as bytes against the draw budget.
+// ---------------------------------------------------------------------------
+bool queue_sprite(sprite_fn fn, uint16_t addr, uint16_t bytes)
+{
+    draw_cmd c;
+    c.type = DRAW_SPRITE;
+    c.x = addr;
+    c.w = bytes;
+    c.sprite = fn;
+    return queue_draw_cmd(&c);
+}
+
+// ---------------------------------------------------------------------------
+// Queue a single line of text at x, y, with the current text settings.
+// The string is copied, so it needn't outlive the call. One longer than
+// DRAW_QUEUE_TEXT is cut short.
+// ---------------------------------------------------------------------------
+bool queue_string(uint16_t x, uint16_t y, const char * str)
+{
+    draw_cmd c;
+    uint8_t len = 0;
+
+    while (str[len]) {
+        len++;
+    }
+    if (len > DRAW_QUEUE_TEXT) {
+        len = DRAW_QUEUE_TEXT;
+    }
+    if (len > DRAW_QUEUE_TEXT - text_used) {
+        compact_draw_text();
+        if (len > DRAW_QUEUE_TEXT - text_used) {
+            return false; // the strings before it haven't been drawn yet
+        }
+    }
+
+    c.type = DRAW_STRING;
+    c.mult = textmultiplier;
+    c.color = textcolor;
+    c.bgcolor = textbgcolor;
+    c.x = x;
+    c.y = y;
+    c.w = len*6*textmultiplier;
+    c.h = 8*textmultiplier;
+    c.text = text_used;
+    c.len = len;
+    for (len = 0; len < c.len; len++) {
+        draw_text[text_used + len] = str[len];
+    }
+    if (!queue_draw_cmd(&c)) {
+        return false;
+    }
+    text_used += c.len;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Draws queued commands, oldest first, until the byte budget is spent.
+// At least one command is drawn, however big. Returns how many are left.
+// ---------------------------------------------------------------------------
+uint8_t flush_draw_queue(void)
+{
+    bitmap_canvas * was = active_canvas;
+    uint16_t spent = 0;
+
+    while (queue_head < queue_tail) {
+        draw_cmd *c = &draw_queue[queue_head];
+        if (c->type != DRAW_NONE) {
+            uint16_t cost = draw_cmd_cost(c);
+            if (spent > 0 && (spent >= draw_budget || cost > draw_budget - spent)) {
+                break; // carry the rest over to the next frame
+            }
+            run_draw_cmd(c);
+            spent = (cost > 0xFFFF - spent) ? 0xFFFF : spent + cost;
+        }
+        queue_head++;
+    }
+    use_canvas(was); // back to what was in use
+    if (queue_head == queue_tail) {
+        queue_head = queue_tail = 0;
+        text_used = 0;
+    }
+    return queue_tail - queue_head;
+}
+
+// ---------------------------------------------------------------------------
+// Draws everything still queued, regardless of budget
+// ---------------------------------------------------------------------------
+void finish_draw_queue(void)
+{
+    uint16_t budget = draw_budget;
+    draw_budget = 0xFFFF;
+    while (flush_draw_queue() > 0) {
+        ;
+    }
+    draw_budget = budget;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+uint8_t draw_queue_length(void)
+{
+    return queue_tail - queue_head;
+}
+
+// ---------------------------------------------------------------------------
+// How many more commands can be queued before they're refused. Superseded
+// ones don't count, as their slots are taken back when it fills up.
+// ---------------------------------------------------------------------------
+uint8_t draw_queue_room(void)
+{
+    uint8_t i, n = DRAW_QUEUE_LEN;
+
+    for (i = queue_head; i < queue_tail; i++) {
+        if (draw_queue[i].type != DRAW_NONE) {
+            n--;
+        }
+    }
+    return n;
+}
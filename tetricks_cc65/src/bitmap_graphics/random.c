@@ -0,0 +1,20 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/random.c
+//
+// Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "bitmap_graphics.h"
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+uint16_t random(uint16_t low_limit, uint16_t high_limit)
+{
+    if (low_limit > high_limit) {
+        swap(low_limit, high_limit);
+    }
+
+    return (uint16_t)((rand() % (high_limit-low_limit)) + low_limit);
+}
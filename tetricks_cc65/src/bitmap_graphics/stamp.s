@@ -0,0 +1,65 @@
+; ---------------------------------------------------------------------------
+; bitmap_graphics/stamp.s
+;
+; Hand-written 6502 for cc65, matching the C reference in stamp.c byte for
+; byte; build with -DBITMAP_GRAPHICS_C to use that instead. __fastcall__:
+; the last argument arrives in A/X and the others come off the C stack.
+; ---------------------------------------------------------------------------
+
+        .export         _xram_stamp_rows
+        .import         _xram_stride
+        .import         popa, popax
+        .importzp       ptr1, ptr2, ptr3, tmp1
+
+RIA_RW0         = $FFE4
+RIA_STEP0       = $FFE5
+RIA_ADDR0       = $FFE6
+
+STAMP_SIZE      = 8             ; as in bitmap_graphics.h
+STAMP_BYTES     = STAMP_SIZE*STAMP_SIZE/2
+
+.code
+
+; ---------------------------------------------------------------------------
+; void xram_stamp_rows (const stamp *s, uint8_t pair, uint16_t addr)
+; Write a 4bpp stamp's rows at addr, xram_stride bytes apart: each byte is
+; base | (pair & mask), with RIA.step0 left at 1.
+; ---------------------------------------------------------------------------
+_xram_stamp_rows:
+        sta     ptr2            ; addr
+        stx     ptr2+1
+        jsr     popa
+        sta     tmp1            ; pair
+        jsr     popax
+        sta     ptr1            ; s->base
+        stx     ptr1+1
+        clc
+        adc     #STAMP_BYTES
+        sta     ptr3            ; s->mask
+        txa
+        adc     #0
+        sta     ptr3+1
+        lda     #1
+        sta     RIA_STEP0
+        ldy     #0
+@row:   lda     ptr2
+        sta     RIA_ADDR0
+        lda     ptr2+1
+        sta     RIA_ADDR0+1
+        .repeat STAMP_SIZE/2
+        lda     (ptr3),y
+        and     tmp1
+        ora     (ptr1),y
+        sta     RIA_RW0
+        iny
+        .endrepeat
+        clc
+        lda     ptr2
+        adc     _xram_stride
+        sta     ptr2
+        lda     ptr2+1
+        adc     _xram_stride+1
+        sta     ptr2+1
+        cpy     #STAMP_BYTES
+        bne     @row
+        rts
@@ -0,0 +1,406 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/xram.c
+//
+// The XRAM cursor, which everything else draws through, and pixel and span
+// plotting on top of it. Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <rp6502.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "bg_internal.h"
+
+// XRAM cursor: what RIA.addr0 and RIA.step0 hold right now (if xc_valid),
+// so runs of output can skip redundant register writes. Pixels narrower than
+// a byte collect in a pending byte first, and only a partly covered byte
+// costs a read-modify-write when it gets flushed.
+bool            xc_valid = false;
+uint16_t        xc_addr = 0;  // RIA.addr0
+int8_t          xc_step = 0;  // RIA.step0
+uint16_t        xram_stride = 320; // bytes per canvas row
+uint16_t        color_lut[16];      // colors 0-15 as pixels, see init_kernels()
+uint8_t         color_patterns[16]; // color_pattern() of colors 0-15
+bool            opaque_black = false;
+const shadow_hooks * shadow = 0;
+bitmap_canvas * shadow_canvas = 0;
+uint16_t        shadow_x0, shadow_y0, shadow_x1, shadow_y1;
+void          (*shadow_fallback)(uint16_t color, uint16_t x, uint16_t y);
+static uint16_t xp_addr = 0;  // address of the pending byte
+static uint8_t  xp_bits = 0;  // pixel bits collected for it
+static uint8_t  xp_mask = 0;  // which of its bits they cover, 0 if none pending
+
+// ---------------------------------------------------------------------------
+// Forget what RIA.addr0 and RIA.step0 hold. Anything else that uses XRAM
+// portal 0 must call this before drawing again (portal 1 is left alone).
+// ---------------------------------------------------------------------------
+void xram_cursor_invalidate(void)
+{
+    xram_cursor_flush();
+    xc_valid = false;
+}
+
+// ---------------------------------------------------------------------------
+// Write a whole byte at addr. When it follows on from the last byte written,
+// RIA.addr0 has already stepped there. Otherwise it is set, and the distance
+// from the last byte becomes the new step, if it fits, for the next byte.
+// ---------------------------------------------------------------------------
+#ifdef XRAM_ASM
+void xram_put(uint16_t addr, uint8_t val);
+#else
+static void xram_put(uint16_t addr, uint8_t val)
+{
+    if (!xc_valid) {
+        RIA.step0 = xc_step = 1;
+        RIA.addr0 = addr;
+    } else if (xc_addr != addr) {
+        int16_t d = (int16_t)(addr - (xc_addr - xc_step)); // from the last byte
+        if (d != 0 && d >= -128 && d <= 127) {
+            RIA.step0 = xc_step = d; // change of direction
+        }
+        RIA.addr0 = addr;
+    }
+    RIA.rw0 = val;
+    xc_addr = addr + xc_step;
+    xc_valid = true;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Write just the mask bits of the byte at addr.
+// ---------------------------------------------------------------------------
+static void xram_rmw(uint16_t addr, uint8_t bits, uint8_t mask)
+{
+    if (!xc_valid || xc_step != 0) {
+        RIA.step0 = xc_step = 0; // so the write lands where the read was
+    }
+    if (!xc_valid || xc_addr != addr) {
+        RIA.addr0 = xc_addr = addr;
+        xc_valid = true;
+    }
+    RIA.rw0 = (RIA.rw0 & ~mask) | bits;
+}
+
+// ---------------------------------------------------------------------------
+// Write out the pending byte, if any.
+// ---------------------------------------------------------------------------
+void xram_cursor_flush(void)
+{
+    if (xp_mask == 0xFF) {
+        xram_put(xp_addr, xp_bits);
+    } else if (xp_mask != 0) {
+        xram_rmw(xp_addr, xp_bits, xp_mask);
+    }
+    xp_mask = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Merge some bits of the byte at addr into the pending byte, and write it
+// straight away once all eight bits are known.
+// ---------------------------------------------------------------------------
+void xram_plot(uint16_t addr, uint8_t bits, uint8_t mask)
+{
+    if (xp_mask != 0 && xp_addr != addr) {
+        xram_cursor_flush();
+    }
+    if (xp_mask == 0) {
+        xp_bits = 0; // starting a new byte
+    }
+    xp_addr = addr;
+    xp_bits = (xp_bits & ~mask) | bits;
+    xp_mask |= mask;
+    if (xp_mask == 0xFF) {
+        xram_put(xp_addr, xp_bits);
+        xp_mask = 0;
+    }
+}
+
+#ifdef XRAM_ASM
+void xram_fill_bytes(uint16_t addr, uint8_t val, uint16_t count);
+#else
+// ---------------------------------------------------------------------------
+// Write val to RIA.rw0 n times, 256 if n is 0.
+// ---------------------------------------------------------------------------
+static void rw0_fill(uint8_t val, uint8_t n)
+{
+#ifdef XRAM_INLINE_ASM
+    __asm__ volatile (
+        "1: sta $ffe4\n"
+        "   dex\n"
+        "   bne 1b\n"
+        : "+x" (n)
+        : "a" (val));
+#else
+    do {
+        RIA.rw0 = val;
+    } while (--n);
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Write val to count bytes from addr, leaving RIA.addr0 at addr + count.
+// ---------------------------------------------------------------------------
+static void xram_fill_bytes(uint16_t addr, uint8_t val, uint16_t count)
+{
+    RIA.addr0 = addr;
+    RIA.step0 = 1;
+    for (; count >= 256; count -= 256) {
+        rw0_fill(val, 0);
+    }
+    if (count) {
+        rw0_fill(val, count);
+    }
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Fill count bytes of XRAM from addr with val.
+// ---------------------------------------------------------------------------
+void xram_fill(uint16_t addr, uint8_t val, uint16_t count)
+{
+    xram_cursor_flush();
+    xram_fill_bytes(addr, val, count);
+    xc_valid = true;
+    xc_step = 1;
+    xc_addr = addr + count;
+}
+
+// ---------------------------------------------------------------------------
+// Plot a pixel through the XRAM cursor, one kernel for each bpp mode, and
+// init_kernels() points plot() at the one for the canvas. Whatever calls
+// plot() must call xram_cursor_flush() when it's done.
+// ---------------------------------------------------------------------------
+static void plot_16bpp(uint16_t color, uint16_t x, uint16_t y)
+{
+    uint16_t addr = canvas_data + xram_stride * y + x*2;
+    if (color < 16) {
+        color = color_lut[color];
+    }
+    xram_cursor_flush();
+    xram_put(addr, color);
+    xram_put(addr+1, color >> 8);
+}
+
+static void plot_8bpp(uint16_t color, uint16_t x, uint16_t y)
+{
+    xram_cursor_flush();
+    xram_put(canvas_data + xram_stride * y + x, color);
+}
+
+static void plot_4bpp(uint16_t color, uint16_t x, uint16_t y)
+{
+    uint8_t shift = 4 * (1 - (x & 1));
+    xram_plot(canvas_data + xram_stride * y + x/2,
+              (color & 15) << shift, 15 << shift);
+}
+
+static void plot_2bpp(uint16_t color, uint16_t x, uint16_t y)
+{
+    uint8_t pat = (color < 16) ? color_patterns[color] : color_pattern(color);
+    uint8_t mask = 0xC0 >> (2 * (x & 3));
+    xram_plot(canvas_data + xram_stride * y + x/4, pat & mask, mask);
+}
+
+static void plot_1bpp(uint16_t color, uint16_t x, uint16_t y)
+{
+    uint8_t pat = (color < 16) ? color_patterns[color] : color_pattern(color);
+    uint8_t mask = 0x80 >> (x & 7);
+    xram_plot(canvas_data + xram_stride * y + x/8, pat & mask, mask);
+}
+
+static void (* const plot_kernels[])(uint16_t color, uint16_t x, uint16_t y) = {
+    plot_1bpp, plot_2bpp, plot_4bpp, plot_8bpp, plot_16bpp
+};
+void (*plot)(uint16_t color, uint16_t x, uint16_t y) = plot_8bpp;
+
+// ---------------------------------------------------------------------------
+// A byte with every pixel in it set to color, so that ANDing it with a pixel's
+// mask gives that pixel's bits. In 16bpp it's the low byte of the color.
+// ---------------------------------------------------------------------------
+static uint8_t make_pattern(uint16_t color)
+{
+    if (bpp_mode == 2) { // 4bpp
+        return (color & 15) * 0x11;
+    } else if (bpp_mode == 1) { // 2bpp
+        if (color > 0 && (color % 4) == 0) {
+            color = 1; // avoid 'accidental' black
+        }
+        return (color & 3) * 0x55;
+    } else if (bpp_mode == 0) { // 1bpp
+        return (color != 0) ? 0xFF : 0x00;
+    }
+    return color;
+}
+
+// ---------------------------------------------------------------------------
+// Pick the plot() kernel for the canvas being set up, and work out its
+// color_lut[] and color_patterns[], so drawing in colors 0-15 can just look
+// them up. In 16bpp the colors are what color() makes of them, opaque but
+// for BLACK. 8bpp's palette starts with the same 16 colors as 4bpp's, and
+// the narrower modes work from the index, so there they stay as they are.
+// These all go along with the canvas when use_canvas() switches away, and
+// the tables are kept in it from here, since only this changes them.
+// ---------------------------------------------------------------------------
+void init_kernels(void)
+{
+    uint8_t i;
+
+    plot = plot_kernels[bpp_mode];
+    if (SHADOWED()) { // it goes by way of the shadow first
+        shadow_fallback = plot;
+        plot = shadow->plot;
+    }
+    for (i = 0; i < 16; i++) {
+        uint16_t c = i;
+        if (bpp_mode == 4) { // 16bpp
+            c = color(i, true);
+            if (opaque_black) {
+                c |= COLOR_ALPHA_MASK;
+            }
+        }
+        color_lut[i] = c;
+        color_patterns[i] = make_pattern(c);
+    }
+    memcpy(active_canvas->color_lut, color_lut, sizeof(color_lut));
+    memcpy(active_canvas->color_patterns, color_patterns, sizeof(color_patterns));
+}
+
+// ---------------------------------------------------------------------------
+// Whether BLACK is opaque in 16bpp, hiding any plane below the canvas, or
+// transparent (the default) as color() has it.
+// ---------------------------------------------------------------------------
+void set_opaque_black(bool opaque)
+{
+    opaque_black = opaque;
+    init_kernels();
+}
+
+// ---------------------------------------------------------------------------
+// What color is as a pixel on this canvas: colors 0-15 are looked up in
+// color_lut[], and anything else already is one.
+// ---------------------------------------------------------------------------
+uint16_t color_value(uint16_t color)
+{
+    return (color < 16) ? color_lut[color] : color;
+}
+
+// ---------------------------------------------------------------------------
+// make_pattern(color), from color_patterns[] where it can be.
+// ---------------------------------------------------------------------------
+uint8_t color_pattern(uint16_t color)
+{
+    if (color < 16) {
+        return color_patterns[color];
+    }
+    return make_pattern(color);
+}
+
+// ---------------------------------------------------------------------------
+// The address of the byte pixel x, y is in, setting *mask to its bits there.
+// In 8bpp and 16bpp that's the whole byte (the first of two in 16bpp).
+// ---------------------------------------------------------------------------
+uint16_t pixel_addr(uint16_t x, uint16_t y, uint8_t * mask)
+{
+    uint16_t row = canvas_data + xram_stride * y;
+
+    if (bpp_mode == 4) { // 16bpp
+        *mask = 0xFF;
+        return row + x*2;
+    } else if (bpp_mode == 3) { // 8bpp
+        *mask = 0xFF;
+        return row + x;
+    } else if (bpp_mode == 2) { // 4bpp
+        *mask = 0xF0 >> (4 * (x & 1));
+        return row + x/2;
+    } else if (bpp_mode == 1) { // 2bpp
+        *mask = 0xC0 >> (2 * (x & 3));
+        return row + x/4;
+    }
+    *mask = 0x80 >> (x & 7); // 1bpp
+    return row + x/8;
+}
+
+// ---------------------------------------------------------------------------
+// True if the box from x0, y0 to x1, y1 (inclusive) is on the canvas in use
+// and has some of the RAM shadow in it, for the primitives that write XRAM
+// bytes directly and have to go by way of plot() instead.
+// ---------------------------------------------------------------------------
+bool shadow_touches(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    return SHADOWED() && x0 < shadow_x1 && x1 >= shadow_x0 &&
+           y0 < shadow_y1 && y1 >= shadow_y0;
+}
+
+// ---------------------------------------------------------------------------
+// Plot w pixels from x, y rightwards. The whole bytes of the run go out
+// through xram_fill_bytes(). In 4, 2 and 1bpp the part bytes at either end
+// are each put together as one masked byte, up to 8 pixels at a time, and
+// 16bpp can only fill when both bytes of the color are the same.
+// The part of it in the RAM shadow, if any, goes there instead.
+// Whatever calls this must call xram_cursor_flush() when it's done.
+// ---------------------------------------------------------------------------
+void span(uint16_t color, uint16_t x, uint16_t y, uint16_t w)
+{
+    uint16_t addr, n;
+    uint8_t val, mask;
+
+    if (w == 0) {
+        return;
+    }
+    if (SHADOWED() && y >= shadow_y0 && y < shadow_y1 &&
+        x < shadow_x1 && x + w > shadow_x0) {
+        // the part inside goes to the shadow, and either end to XRAM
+        uint16_t a = (x > shadow_x0) ? x : shadow_x0;
+        uint16_t b = (x + w < shadow_x1) ? x + w : shadow_x1;
+        span(color, x, y, a - x);
+        shadow->span(color, a, y, b - a);
+        span(color, b, y, x + w - b);
+        return;
+    }
+    if (bpp_mode == 4) { // 16bpp
+        color = color_value(color);
+        if ((color >> 8) != (color & 0xFF)) {
+            for (; w; w--) {
+                plot(color, x++, y);
+            }
+            return;
+        }
+        n = w*2;
+        addr = canvas_data + xram_stride * y + x*2;
+        val = color;
+    } else if (bpp_mode == 3) { // 8bpp
+        n = w;
+        addr = canvas_data + xram_stride * y + x;
+        val = color;
+    } else {
+        uint8_t bpp = 1 << bpp_mode;   // 1, 2 or 4
+        uint8_t ppb = 8 >> bpp_mode;   // pixels per byte
+        uint8_t k = x & (ppb - 1);     // pixels into the first byte
+
+        val = color_pattern(color);
+        addr = pixel_addr(x, y, &mask);
+        if (k) { // the rest of the first byte
+            mask = 0xFF >> (k * bpp);
+            if (w < ppb - k) {
+                mask &= ~(0xFF >> ((k + w) * bpp));
+                w = 0;
+            } else {
+                w -= ppb - k;
+            }
+            xram_plot(addr++, val & mask, mask);
+        }
+        n = w >> (3 - bpp_mode);
+        w &= ppb - 1;
+        if (w) { // the start of the byte after the whole ones
+            mask = ~(0xFF >> (w * bpp));
+            if (n) {
+                xram_fill(addr, val, n);
+            }
+            xram_plot(addr + n, val & mask, mask);
+            return;
+        }
+    }
+    if (n) {
+        xram_fill(addr, val, n);
+    }
+}
@@ -0,0 +1,126 @@
+; ---------------------------------------------------------------------------
+; bitmap_graphics/xram.s
+;
+; Hand-written 6502 for cc65, matching the C reference in xram.c byte for
+; byte; build with -DBITMAP_GRAPHICS_C to use that instead. __fastcall__:
+; the last argument arrives in A/X and the others come off the C stack.
+; ---------------------------------------------------------------------------
+
+        .export         _xram_put
+        .export         _xram_fill_bytes
+        .import         _xc_valid, _xc_addr, _xc_step
+        .import         popa, popax
+        .importzp       ptr1, tmp1, tmp2, tmp3
+
+RIA_RW0         = $FFE4
+RIA_STEP0       = $FFE5
+RIA_ADDR0       = $FFE6
+
+.code
+
+; ---------------------------------------------------------------------------
+; void xram_put (uint16_t addr, uint8_t val)
+; Write a whole byte at addr through the XRAM cursor, see xram.c.
+; ---------------------------------------------------------------------------
+_xram_put:
+        pha                     ; val
+        jsr     popax
+        sta     ptr1            ; addr
+        stx     ptr1+1
+        ldy     _xc_valid
+        bne     @valid
+        lda     #1
+        sta     _xc_step
+        sta     RIA_STEP0
+        bne     @seek           ; always
+
+@valid: cmp     _xc_addr        ; already there?
+        bne     @jump
+        cpx     _xc_addr+1
+        beq     @write
+
+; d = addr - (xc_addr - xc_step), the distance from the last byte
+@jump:  ldy     #0
+        lda     _xc_step
+        bpl     :+
+        dey
+:       sty     tmp1            ; xc_step's high byte
+        sec
+        lda     _xc_addr
+        sbc     _xc_step
+        sta     tmp2
+        lda     _xc_addr+1
+        sbc     tmp1
+        sta     tmp3
+        sec
+        lda     ptr1
+        sbc     tmp2
+        tay                     ; d low
+        lda     ptr1+1
+        sbc     tmp3            ; d high
+        beq     @pos
+        cmp     #$FF
+        bne     @seek           ; d < -128 or d > 127, keep the step
+        cpy     #$80
+        bcc     @seek
+        bcs     @step           ; always
+@pos:   cpy     #$80
+        bcs     @seek
+        tya
+        beq     @seek           ; d == 0 would stop the cursor dead
+@step:  sty     _xc_step        ; change of direction
+        sty     RIA_STEP0
+
+@seek:  lda     ptr1
+        sta     RIA_ADDR0
+        lda     ptr1+1
+        sta     RIA_ADDR0+1
+
+@write: pla
+        sta     RIA_RW0
+        ldx     #0              ; xc_addr = addr + xc_step
+        lda     _xc_step
+        bpl     :+
+        dex
+:       clc
+        adc     ptr1
+        sta     _xc_addr
+        txa
+        adc     ptr1+1
+        sta     _xc_addr+1
+        lda     #1
+        sta     _xc_valid
+        rts
+
+; ---------------------------------------------------------------------------
+; void xram_fill_bytes (uint16_t addr, uint8_t val, uint16_t count)
+; Write val to count bytes from addr, leaving RIA.addr0 at addr + count.
+; ---------------------------------------------------------------------------
+_xram_fill_bytes:
+        sta     ptr1            ; count
+        stx     ptr1+1
+        jsr     popa
+        sta     tmp1            ; val
+        jsr     popax
+        sta     RIA_ADDR0       ; addr
+        stx     RIA_ADDR0+1
+        lda     #1
+        sta     RIA_STEP0
+        lda     tmp1
+        ldx     ptr1+1          ; whole pages first, 4 bytes a lap
+        beq     @part
+@page:  ldy     #256/4
+@lap:   sta     RIA_RW0
+        sta     RIA_RW0
+        sta     RIA_RW0
+        sta     RIA_RW0
+        dey
+        bne     @lap
+        dex
+        bne     @page
+@part:  ldy     ptr1
+        beq     @done
+@byte:  sta     RIA_RW0
+        dey
+        bne     @byte
+@done:  rts
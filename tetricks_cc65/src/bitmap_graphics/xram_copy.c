@@ -0,0 +1,72 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/xram_copy.c
+//
+// Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <rp6502.h>
+#include <stdint.h>
+#include "bg_internal.h"
+
+#ifdef XRAM_ASM
+void xram_copy_bytes(uint16_t dst, uint16_t src, uint16_t count);
+#else
+// ---------------------------------------------------------------------------
+// Move n bytes from RIA.rw0 to RIA.rw1, 256 if n is 0.
+// ---------------------------------------------------------------------------
+static void rw0_copy(uint8_t n)
+{
+#ifdef XRAM_INLINE_ASM
+    __asm__ volatile (
+        "1: lda $ffe4\n"
+        "   sta $ffe8\n"
+        "   dex\n"
+        "   bne 1b\n"
+        : "+x" (n)
+        :
+        : "a");
+#else
+    do {
+        RIA.rw1 = RIA.rw0;
+    } while (--n);
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Copy count bytes, reading through portal 0 and writing through portal 1.
+// When dst is above src it copies from the end down, so overlaps are fine.
+// ---------------------------------------------------------------------------
+static void xram_copy_bytes(uint16_t dst, uint16_t src, uint16_t count)
+{
+    int8_t step = 1;
+
+    if (count == 0) {
+        return;
+    }
+    if (dst > src) {
+        step = -1;
+        src += count - 1;
+        dst += count - 1;
+    }
+    RIA.step0 = step;
+    RIA.step1 = step;
+    RIA.addr0 = src;
+    RIA.addr1 = dst;
+    for (; count >= 256; count -= 256) {
+        rw0_copy(0);
+    }
+    if (count) {
+        rw0_copy(count);
+    }
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Copy count bytes of XRAM from src to dst. This uses portal 1 as well.
+// ---------------------------------------------------------------------------
+void xram_copy(uint16_t dst, uint16_t src, uint16_t count)
+{
+    xram_cursor_flush();
+    xram_copy_bytes(dst, src, count);
+    xc_valid = false;
+}
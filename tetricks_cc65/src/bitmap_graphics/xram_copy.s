@@ -0,0 +1,92 @@
+; ---------------------------------------------------------------------------
+; bitmap_graphics/xram_copy.s
+;
+; Hand-written 6502 for cc65, matching the C reference in xram_copy.c byte for
+; byte; build with -DBITMAP_GRAPHICS_C to use that instead. __fastcall__:
+; the last argument arrives in A/X and the others come off the C stack.
+; ---------------------------------------------------------------------------
+
+        .export         _xram_copy_bytes
+        .import         popax
+        .importzp       ptr1, ptr2, ptr3, tmp1, tmp2
+
+RIA_RW0         = $FFE4
+RIA_STEP0       = $FFE5
+RIA_ADDR0       = $FFE6
+RIA_RW1         = $FFE8
+RIA_STEP1       = $FFE9
+RIA_ADDR1       = $FFEA
+
+.code
+
+; ---------------------------------------------------------------------------
+; void xram_copy_bytes (uint16_t dst, uint16_t src, uint16_t count)
+; Copy count bytes, reading through portal 0 and writing through portal 1.
+; When dst is above src it copies from the end down, so overlaps are fine.
+; ---------------------------------------------------------------------------
+_xram_copy_bytes:
+        sta     ptr1            ; count
+        stx     ptr1+1
+        jsr     popax
+        sta     ptr2            ; src
+        stx     ptr2+1
+        jsr     popax
+        sta     ptr3            ; dst
+        stx     ptr3+1
+        lda     ptr1
+        ora     ptr1+1
+        beq     @done
+        ldy     #1              ; step
+        lda     ptr2
+        cmp     ptr3
+        lda     ptr2+1
+        sbc     ptr3+1
+        bcs     @go             ; src >= dst, forwards
+        lda     ptr1            ; tmp1/2 = count - 1
+        sec
+        sbc     #1
+        sta     tmp1
+        lda     ptr1+1
+        sbc     #0
+        sta     tmp2
+        clc
+        lda     ptr2
+        adc     tmp1
+        sta     ptr2
+        lda     ptr2+1
+        adc     tmp2
+        sta     ptr2+1
+        clc
+        lda     ptr3
+        adc     tmp1
+        sta     ptr3
+        lda     ptr3+1
+        adc     tmp2
+        sta     ptr3+1
+        ldy     #$FF
+@go:    sty     RIA_STEP0
+        sty     RIA_STEP1
+        lda     ptr2
+        sta     RIA_ADDR0
+        lda     ptr2+1
+        sta     RIA_ADDR0+1
+        lda     ptr3
+        sta     RIA_ADDR1
+        lda     ptr3+1
+        sta     RIA_ADDR1+1
+        ldx     ptr1+1          ; whole pages first
+        beq     @part
+        ldy     #0
+@page:  lda     RIA_RW0
+        sta     RIA_RW1
+        dey
+        bne     @page
+        dex
+        bne     @page
+@part:  ldy     ptr1
+        beq     @done
+@byte:  lda     RIA_RW0
+        sta     RIA_RW1
+        dey
+        bne     @byte
+@done:  rts
@@ -0,0 +1,26 @@
+// ---------------------------------------------------------------------------
+// rng.h
+//
+// A small seedable random number generator, and a bag randomizer on it.
+//
+// rng_seed() starts the sequence over, and a seed always gives the same
+// numbers. rng_next() returns the next 16-bit number, never 0, rng_below(n)
+// one from 0 to n-1 (0 when n is 0), and bag_next() one from 0 to
+// BAG_SIZE-1 dealt from a shuffled bag, which holds each of them once.
+// bag_reset() empties the bag.
+// ---------------------------------------------------------------------------
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+#define BAG_SIZE 7 // one of each shape
+
+void rng_seed(uint16_t seed);
+uint16_t rng_next(void);
+uint8_t rng_below(uint8_t n);
+void bag_reset(void);
+uint8_t bag_next(void);
+
+#endif // RNG_H
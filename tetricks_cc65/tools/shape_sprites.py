@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+#
+# Compile the tetricks shapes into straight-line sprite code.
+#
+# Reads shapes[] and block_stamp from tetricks.c, with the color names from
+# colors.h, and writes one block writer per block color. Each one writes a
+# block stamp's bytes at address a through XRAM portal 0, a row at a time:
+# no bit tests, no loops and no address math beyond a constant add per row.
+# Bytes that only hold the stamp's base pattern (the inside of a block, and
+# the gap below it) are left alone, unless writing a few of them saves
+# setting RIA.addr0 again. Erasing is drawing in color 0.
+#
+# Then there's one function per shape, rotation and draw/erase, which calls
+# the block writer for its color at each of its 4 blocks, relative to the
+# 4x4 box at address a. Unrolling whole shapes instead would take ten times
+# the code, for 46 functions that are mostly the same stores.
+
+import re
+import argparse
+
+STAMP_SIZE = 8
+CELL_BYTES = STAMP_SIZE // 2  # 4bpp
+MAX_FILL = 3  # base bytes worth writing to carry on a run instead
+
+
+def read_colors(path):
+    """Returns the #define NAME value colors in colors.h."""
+    with open(path) as f:
+        text = f.read()
+    return {m.group(1): int(m.group(2), 0)
+            for m in re.finditer(r"#define\s+(\w+)\s+(\d+|0x[0-9a-fA-F]+)\b", text)}
+
+
+def value(token, colors):
+    token = token.strip()
+    return colors[token] if token in colors else int(token, 0)
+
+
+def read_shapes(text, colors):
+    """Returns (name, color, [4 block masks]) for each entry of shapes[]."""
+    body = re.search(r"shapes\[\]\s*=\s*\{(.*?)\n\};", text, re.S).group(1)
+    shapes = []
+    for m in re.finditer(r"\{(\w+),\s*//\s*\d+:\s*([^\n]*)\n\s*\{([^}]*)\}", body):
+        masks = [int(b, 2) for b in re.findall(r"0b([01]+)", m.group(3))]
+        shapes.append((m.group(2).strip(), value(m.group(1), colors), masks))
+    return shapes
+
+
+def read_stamp(text, colors, name):
+    """Returns the base and mask bytes of a stamp initializer."""
+    body = re.search(name + r"\s*=\s*\{\s*\{(.*?)\},\s*\{(.*?)\}\s*\};", text, re.S)
+    body_text = [re.sub(r"//[^\n]*", "", b) for b in body.groups()]
+    base, mask = [[value(v, colors) for v in b.split(",") if v.strip()]
+                  for b in body_text]
+    base += [0] * (STAMP_SIZE * CELL_BYTES - len(base))
+    return base, mask
+
+
+def sprite_bytes(blocks, color, base, mask, stride):
+    """Returns {offset: (byte, colored)} for every stamp byte of a shape."""
+    pair = (color & 15) * 0x11
+    out = {}
+    for i in range(16):
+        if not blocks & (1 << i):
+            continue
+        cell = (i // 4) * STAMP_SIZE * stride + (i % 4) * CELL_BYTES
+        for j in range(STAMP_SIZE):
+            for k in range(CELL_BYTES):
+                n = j * CELL_BYTES + k
+                out[cell + j * stride + k] = (base[n] | (pair & mask[n]), mask[n] != 0)
+    return out
+
+
+def runs(data):
+    """Splits the bytes to write into runs of consecutive addresses."""
+    wanted = sorted(off for off, (_, colored) in data.items() if colored)
+    result = []
+    for off in wanted:
+        if result:
+            last = result[-1][0] + len(result[-1][1])
+            gap = off - last
+            if 0 <= gap <= MAX_FILL and all(o in data for o in range(last, off)):
+                result[-1][1].extend(data[o][0] for o in range(last, off + 1))
+                continue
+        result.append((off, [data[off][0]]))
+    return result
+
+
+def block_offsets(blocks, stride):
+    """Returns the XRAM offset of each block set in a 4x4 box."""
+    return [(i // 4) * STAMP_SIZE * stride + (i % 4) * CELL_BYTES
+            for i in range(16) if blocks & (1 << i)]
+
+
+def write_block(f, color, base, mask, stride):
+    """Writes the block writer for one color, and returns its name and bytes."""
+    spans = runs(sprite_bytes(1, color, base, mask, stride))
+    count = sum(len(b) for _, b in spans)
+    fn = "block_%d" % color
+    f.write("\n// block in color %d: %d bytes in %d runs\n" % (color, count, len(spans)))
+    f.write("static void %s(uint16_t a)\n{\n" % fn)
+    for off, data in spans:
+        f.write("    RIA.addr0 = a + %d;\n" % off if off else "    RIA.addr0 = a;\n")
+        for b in data:
+            f.write("    RIA.rw0 = 0x%02X;\n" % b)
+    f.write("}\n")
+    return fn, count
+
+
+def write_sprites(c_path, h_path, shapes, base, mask, stride):
+    header = h_path.replace("\\", "/").split("/")[-1]
+    guard = header.upper().replace(".", "_")
+    names = []
+    sizes = []
+    writers = {}  # block color: (writer, bytes it writes)
+    bodies = {}  # identical sprites, like a bar turned 180, share a function
+    with open(c_path, "w") as f:
+        f.write("// Generated by tools/shape_sprites.py from tetricks.c -- do not edit.\n\n")
+        f.write("#include <rp6502.h>\n#include <stdint.h>\n#include \"%s\"\n" % header)
+        for color in [0] + sorted(set(c & 15 for _, c, _ in shapes)):
+            writers[color] = write_block(f, color, base, mask, stride)
+        for s, (name, color, rotations) in enumerate(shapes):
+            row_names = []
+            row_sizes = []
+            for r, blocks in enumerate(rotations):
+                pair_names = []
+                offsets = block_offsets(blocks, stride)
+                for variant, c in (("draw", color & 15), ("erase", 0)):
+                    writer, count = writers[c]
+                    key = (writer, tuple(offsets))
+                    if key not in bodies:
+                        fn = "sprite_%d_%d_%s" % (s, r, variant)
+                        bodies[key] = fn
+                        f.write("\n// %d: %s, %d, %s\n" % (s, name, r * 90, variant))
+                        f.write("static void %s(uint16_t a)\n{\n" % fn)
+                        for off in offsets:
+                            f.write("    %s(a + %d);\n" % (writer, off) if off
+                                    else "    %s(a);\n" % writer)
+                        f.write("}\n")
+                    pair_names.append(bodies[key])
+                row_names.append(pair_names)
+                row_sizes.append(count * len(offsets))
+            names.append(row_names)
+            sizes.append(row_sizes)
+
+        f.write("\nconst sprite_fn shape_sprites[SHAPE_SPRITE_SHAPES][4][2] = {\n")
+        f.write(",\n".join("    {%s}" % ", ".join("{%s}" % ", ".join(p) for p in row)
+                           for row in names))
+        f.write("\n};\n\nconst uint8_t shape_sprite_bytes[SHAPE_SPRITE_SHAPES][4] = {\n")
+        f.write(",\n".join("    {%s}" % ", ".join("%d" % n for n in row) for row in sizes))
+        f.write("\n};\n")
+
+    with open(h_path, "w") as f:
+        f.write("// Generated by tools/shape_sprites.py from tetricks.c -- do not edit.\n")
+        f.write("//\n// shape_sprites[shape][rotation][SPRITE_DRAW or SPRITE_ERASE] write a\n")
+        f.write("// shape's block stamps in 4bpp, with the top left of its 4x4 box at\n")
+        f.write("// XRAM address a, for a canvas SHAPE_SPRITE_STRIDE bytes wide.\n\n")
+        f.write("#ifndef %s\n#define %s\n\n" % (guard, guard))
+        f.write("#include <stdint.h>\n#include \"bitmap_graphics.h\"\n\n")
+        f.write("#define SHAPE_SPRITE_SHAPES %d\n" % len(shapes))
+        f.write("#define SHAPE_SPRITE_STRIDE %d\n" % stride)
+        f.write("#define SPRITE_DRAW  0\n#define SPRITE_ERASE 1\n\n")
+        f.write("extern const sprite_fn shape_sprites[SHAPE_SPRITE_SHAPES][4][2];\n")
+        f.write("extern const uint8_t shape_sprite_bytes[SHAPE_SPRITE_SHAPES][4];\n")
+        f.write("\n#endif // %s\n" % guard)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("source", help="tetricks.c, with shapes[] and block_stamp")
+    parser.add_argument("colors", help="colors.h, for the color names")
+    parser.add_argument("-s", "--stride", type=int, required=True,
+                        help="canvas bytes per pixel row")
+    parser.add_argument("-o", "--out", required=True, help="C file to write")
+    parser.add_argument("--header", required=True, help="header to write")
+    args = parser.parse_args()
+
+    colors = read_colors(args.colors)
+    with open(args.source) as f:
+        text = f.read()
+    shapes = read_shapes(text, colors)
+    if not shapes:
+        parser.error("no shapes[] found in %s" % args.source)
+    base, mask = read_stamp(text, colors, "block_stamp")
+    write_sprites(args.out, args.header, shapes, base, mask, args.stride)
+
+
+if __name__ == "__main__":
+    main()
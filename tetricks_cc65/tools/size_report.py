@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+#
+# Report which objects of a static library a program actually links.
+#
+# The linker only pulls an object out of an archive when something refers to
+# it, so splitting a library into one object per primitive family means a
+# program carries only the families it calls. This lists each object in the
+# archive with its size, marks it linked or dropped going by the program's
+# link map, and totals up the bytes the split saved.
+#
+# Sizes come from od65 for cc65 archives, or from llvm-size for llvm-mos
+# ones (which needs -fno-lto, since LTO archives hold bitcode instead).
+#
+# With --ram-end it also finds where the program's last segment ends in the
+# link map, and fails if that's past the given address, so a program that
+# has grown into the C stack stops the build instead of crashing at run time.
+
+import os
+import re
+import argparse
+import subprocess
+import sys
+import tempfile
+
+
+def od65_sizes(lib, ar65, od65):
+    """Returns {member: bytes} for a cc65 archive, via ar65 and od65."""
+    # they run from a scratch directory, so paths have to be absolute
+    ar65, od65 = [os.path.abspath(t) if os.sep in t else t for t in (ar65, od65)]
+    listing = subprocess.run([ar65, "t", os.path.abspath(lib)], check=True,
+                             capture_output=True, text=True).stdout
+    members = [m.strip() for m in listing.splitlines() if m.strip()]
+    sizes = {}
+    with tempfile.TemporaryDirectory() as tmp:
+        subprocess.run([ar65, "x", os.path.abspath(lib)] + members,
+                       cwd=tmp, check=True)
+        for member in members:
+            dump = subprocess.run([od65, "--dump-segsize", member], cwd=tmp,
+                                  check=True, capture_output=True, text=True).stdout
+            sizes[member] = sum(int(n) for seg, n in
+                                re.findall(r"^\s*(\w+):\s+(\d+)\s*$", dump, re.M)
+                                if seg != "Count")
+    return sizes
+
+
+def llvm_sizes(lib, llvm_size):
+    """Returns {member: bytes} for an llvm archive, via llvm-size."""
+    listing = subprocess.run([llvm_size, "-B", lib], check=True,
+                             capture_output=True, text=True).stdout
+    sizes = {}
+    for line in listing.splitlines()[1:]:
+        m = re.match(r"\s*(\d+)\s+(\d+)\s+(\d+)\s+\d+\s+\w+\s+(\S+)", line)
+        if m:
+            sizes[m.group(4)] = int(m.group(1)) + int(m.group(2)) + int(m.group(3))
+    return sizes
+
+
+def image_end(map_text):
+    """Returns the address past the last byte the link map puts in RAM."""
+    # ld65 lists segments as "NAME START END SIZE ALIGN", in hex
+    segments = re.search(r"^Segment list:\n(.*?)(?:\n\n|\Z)", map_text, re.M | re.S)
+    ends = []
+    if segments:
+        for start, end, size in re.findall(
+                r"^\w+\s+([0-9A-F]{6})\s+([0-9A-F]{6})\s+([0-9A-F]{6})\s",
+                segments.group(1), re.M):
+            if int(start, 16) >= 0x200 and int(size, 16) > 0:
+                ends.append(int(end, 16) + 1)
+    else:
+        # lld lists output sections as "VMA LMA SIZE ALIGN NAME", in hex, with
+        # what goes into them indented further below
+        for vma, size in re.findall(
+                r"^\s*([0-9a-f]+)\s+[0-9a-f]+\s+([0-9a-f]+)\s+\d+ \S+\s*$",
+                map_text, re.M):
+            if 0x200 <= int(vma, 16) < 0x10000 and int(size, 16) > 0:
+                ends.append(int(vma, 16) + int(size, 16))
+    return max(ends) if ends else None
+
+
+def linked(map_text, lib, member):
+    """True if the link map shows member coming out of lib."""
+    name = re.escape(os.path.basename(lib))
+    return re.search(name + r"\(" + re.escape(member) + r"\)", map_text) is not None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--map", required=True, help="the program's link map")
+    parser.add_argument("--lib", help="static library archive")
+    parser.add_argument("--ar65", help="ar65, for a cc65 archive")
+    parser.add_argument("--od65", help="od65, for a cc65 archive")
+    parser.add_argument("--llvm-size", help="llvm-size, for an llvm archive")
+    parser.add_argument("--ram-end", type=lambda v: int(v, 0),
+                        help="fail if the program reaches past this address")
+    args = parser.parse_args()
+    with open(args.map) as f:
+        map_text = f.read()
+
+    if args.ram_end is not None:
+        end = image_end(map_text)
+        if end is None:
+            parser.error("no segments found in %s" % args.map)
+        if end > args.ram_end:
+            print("%s: program ends at $%04X, %d bytes past $%04X"
+                  % (os.path.basename(args.map), end, end - args.ram_end, args.ram_end))
+            return 1
+        print("%s: program ends at $%04X, %d bytes free below $%04X"
+              % (os.path.basename(args.map), end, args.ram_end - end, args.ram_end))
+    if not args.lib:
+        return 0
+
+    if args.llvm_size:
+        sizes = llvm_sizes(args.lib, args.llvm_size)
+    elif args.ar65 and args.od65:
+        sizes = od65_sizes(args.lib, args.ar65, args.od65)
+    else:
+        parser.error("needs --ar65 and --od65, or --llvm-size")
+
+    kept = dropped = 0
+    print("%s in %s:" % (os.path.basename(args.lib), os.path.basename(args.map)))
+    for member in sorted(sizes):
+        is_linked = linked(map_text, args.lib, member)
+        if is_linked:
+            kept += sizes[member]
+        else:
+            dropped += sizes[member]
+        print("  %-24s %6d  %s" % (member, sizes[member],
+                                   "linked" if is_linked else "dropped"))
+    print("  %d bytes linked, %d of %d bytes dropped" % (kept, dropped, kept + dropped))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
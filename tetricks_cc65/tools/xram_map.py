@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+#
+# Print the XRAM map a program was built with.
+#
+# Reads the XRAM_MAP(X) list of X(name, address, bytes) in a header like
+# src/xram_map.h, works out each address and size the way the preprocessor
+# would, given the same -D definitions, and lists the regions in address
+# order with the gaps between them and the headroom left in the 64K. It only
+# follows #define, #if/#ifdef/#ifndef/#else/#endif and integer arithmetic,
+# which is all the header should use. Overlapping regions are an error.
+
+import re
+import sys
+import argparse
+
+XRAM_SIZE = 0x10000
+
+
+def join_lines(text):
+    """Strips comments and joins backslash-continued lines."""
+    text = re.sub(r"/\*.*?\*/", " ", text, flags=re.S)
+    text = re.sub(r"//[^\n]*", "", text)
+    return text.replace("\\\n", " ").splitlines()
+
+
+def evaluate(expr, defines, functions):
+    """Works out an integer expression, expanding macros as cpp would."""
+    expr = re.sub(r"defined\s*\(?\s*(\w+)\s*\)?",
+                  lambda m: "1" if m.group(1) in defines or m.group(1) in functions
+                  else "0", expr)
+    for _ in range(64):
+        expanded = re.sub(r"\b[A-Za-z_]\w*\b",
+                          lambda m: "(" + defines[m.group(0)] + ")"
+                          if m.group(0) in defines else m.group(0), expr)
+        if expanded == expr:
+            break
+        expr = expanded
+    expr = re.sub(r"\b(0x[0-9a-fA-F]+|\d+)[uUlL]+\b", r"\1", expr)
+    expr = re.sub(r"\b[A-Za-z_]\w*\b", "0", expr)  # undefined names are 0
+    expr = expr.replace("/", "//").replace("&&", " and ").replace("||", " or ")
+    expr = re.sub(r"!(?!=)", " not ", expr)
+    return int(eval(expr, {"__builtins__": {}}))
+
+
+def preprocess(path, defines):
+    """Returns the object-like and function-like #defines that survive."""
+    functions = {}
+    stack = []  # (this branch taken, some branch already taken)
+    for line in join_lines(open(path).read()):
+        m = re.match(r"\s*#\s*(\w+)\s*(.*)", line)
+        if not m:
+            continue
+        directive, rest = m.groups()
+        live = all(taken for taken, _ in stack)
+        if directive in ("if", "ifdef", "ifndef"):
+            if not live:
+                stack.append((False, True))
+                continue
+            if directive == "ifdef":
+                taken = rest.strip() in defines or rest.strip() in functions
+            elif directive == "ifndef":
+                taken = not (rest.strip() in defines or rest.strip() in functions)
+            else:
+                taken = evaluate(rest, defines, functions) != 0
+            stack.append((taken, taken))
+        elif directive == "elif":
+            _, done = stack.pop()
+            live = all(taken for taken, _ in stack)
+            taken = live and not done and evaluate(rest, defines, functions) != 0
+            stack.append((taken, done or taken))
+        elif directive == "else":
+            _, done = stack.pop()
+            stack.append((not done, True))
+        elif directive == "endif":
+            stack.pop()
+        elif directive == "define" and live:
+            f = re.match(r"(\w+)\(([^)]*)\)\s*(.*)", rest)
+            if f:
+                functions[f.group(1)] = ([a.strip() for a in f.group(2).split(",")],
+                                         f.group(3))
+            else:
+                name, _, body = rest.partition(" ")
+                defines[name.strip()] = body.strip() or "1"
+        elif directive == "error" and live:
+            sys.exit("xram_map: #error " + rest)
+    return functions
+
+
+def regions(name, defines, functions):
+    """Expands X-macro list name into (region, address, bytes)."""
+    found = []
+
+    def expand(macro):
+        params, body = functions[macro]
+        body = re.sub(r"\b" + params[0] + r"\b", "X", body)
+        for m in re.finditer(r"\b(\w+)\(X\)|\bX\(([^()]*(?:\([^()]*\)[^()]*)*)\)", body):
+            if m.group(1):
+                expand(m.group(1))
+            else:
+                args = [a.strip() for a in m.group(2).split(",")]
+                found.append((args[0], evaluate(args[1], defines, functions),
+                              evaluate(args[2], defines, functions)))
+
+    expand(name)
+    return found
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("header", help="header with the XRAM_MAP list")
+    parser.add_argument("-D", dest="defines", action="append", default=[],
+                        help="a definition the program was built with")
+    parser.add_argument("--map", default="XRAM_MAP", help="name of the list")
+    args = parser.parse_args()
+
+    defines = {}
+    for d in args.defines:
+        name, _, value = d.partition("=")
+        defines[name] = value or "1"
+    functions = preprocess(args.header, defines)
+    regs = sorted((r for r in regions(args.map, defines, functions) if r[2] > 0),
+                  key=lambda r: r[1])
+
+    print("XRAM map:")
+    used = 0
+    at = 0
+    for name, addr, size in regs:
+        if addr < at:
+            sys.exit("xram_map: %s at 0x%04X overlaps what's before it" % (name, addr))
+        if addr > at:
+            print("  0x%04X-0x%04X %6d  (free)" % (at, addr - 1, addr - at))
+        print("  0x%04X-0x%04X %6d  %s" % (addr, addr + size - 1, size, name))
+        used += size
+        at = addr + size
+    if at > XRAM_SIZE:
+        sys.exit("xram_map: the map runs 0x%X bytes past the end of XRAM" % (at - XRAM_SIZE))
+    if at < XRAM_SIZE:
+        print("  0x%04X-0x%04X %6d  (free)" % (at, XRAM_SIZE - 1, XRAM_SIZE - at))
+    print("  %d bytes used, %d free" % (used, XRAM_SIZE - used))
+
+
+if __name__ == "__main__":
+    main()
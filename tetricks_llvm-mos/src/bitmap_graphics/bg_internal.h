@@ -0,0 +1,96 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/bg_internal.h
+//
+// What the bitmap_graphics translation units share with each other, and
+// nothing a program using the library should need. Each primitive family is
+// its own object in the library archive, so the linker only pulls in the
+// ones a program calls.
+// ---------------------------------------------------------------------------
+
+#ifndef BG_INTERNAL_H
+#define BG_INTERNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bitmap_graphics.h"
+
+// With cc65 the XRAM kernels are the 6502 in the .s files here, and with
+// llvm-mos their inner loops are inline asm. -DBITMAP_GRAPHICS_C builds the
+// plain C reference versions of both instead.
+#if defined(__CC65__) && !defined(BITMAP_GRAPHICS_C)
+#define XRAM_ASM
+#elif defined(__mos__) && !defined(BITMAP_GRAPHICS_C)
+#define XRAM_INLINE_ASM
+#endif
+
+// canvas.c: the canvas being drawn on, which use_canvas() swaps in and out
+// of a bitmap_canvas, default_canvas to begin with
+extern uint16_t canvas_data;
+extern uint16_t canvas_w;
+extern uint16_t canvas_h;
+extern uint8_t  bpp_mode; // 0-4 for 1, 2, 4, 8 and 16bpp
+extern uint8_t  bpp_mode_to_bpp[];
+extern uint16_t canvas_bytes; // xram_stride * canvas_h
+extern uint16_t palette_ptr;  // XRAM address of the palette, 0xFFFF if built-in
+extern bitmap_canvas   default_canvas;
+extern bitmap_canvas * active_canvas; // whose settings these are
+
+// xram.c: the XRAM cursor. The .s kernels use xc_ and xram_stride too.
+extern bool     xc_valid;
+extern uint16_t xc_addr;
+extern int8_t   xc_step;
+extern uint16_t xram_stride; // bytes per canvas row
+extern uint16_t color_lut[16];      // see color_value()
+extern uint8_t  color_patterns[16]; // see color_pattern()
+extern bool     opaque_black;
+extern void   (*plot)(uint16_t color, uint16_t x, uint16_t y); // for bpp_mode
+void xram_plot(uint16_t addr, uint8_t bits, uint8_t mask);
+void span(uint16_t color, uint16_t x, uint16_t y, uint16_t w);
+void init_kernels(void);
+uint16_t color_value(uint16_t color);
+uint8_t color_pattern(uint16_t color);
+uint16_t pixel_addr(uint16_t x, uint16_t y, uint8_t * mask);
+
+// xram.c: the RAM shadow, if shadow.c set one up. The primitives ask
+// SHADOWED() and hand whatever lands inside it to the hooks, which only
+// shadow.c fills in, so programs without a shadow don't link it.
+typedef struct {
+    void    (*plot)(uint16_t color, uint16_t x, uint16_t y);
+    void    (*span)(uint16_t color, uint16_t x, uint16_t y, uint16_t w);
+    uint8_t (*stamp)(const stamp * s, uint16_t color, uint16_t addr); // a CLIP_
+    void    (*erase)(void);
+} shadow_hooks;
+extern const shadow_hooks * shadow;
+extern bitmap_canvas * shadow_canvas; // 0 if there's no shadow
+extern uint16_t shadow_x0, shadow_y0; // what's shadowed, in pixels
+extern uint16_t shadow_x1, shadow_y1; // (exclusive)
+extern void   (*shadow_fallback)(uint16_t color, uint16_t x, uint16_t y);
+#define SHADOWED() (shadow_canvas == active_canvas)
+bool shadow_touches(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
+
+// clip.c: the clip rectangle, inclusive, and drawing within it
+#define CLIP_OUT  0
+#define CLIP_IN   1
+#define CLIP_PART 2
+extern int16_t  clip_x0;
+extern int16_t  clip_y0;
+extern int16_t  clip_x1;
+extern int16_t  clip_y1;
+bool    clip_range(uint16_t * p, uint16_t * n, int16_t lo, int16_t hi);
+uint8_t clip_box(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+#define CLIP_IS_CANVAS() (clip_x0 == 0 && clip_y0 == 0 && \
+                          clip_x1 == canvas_w - 1 && clip_y1 == canvas_h - 1)
+bool    clip_line(int16_t * x0, int16_t * y0, int16_t * x1, int16_t * y1);
+void    clip_plot(uint16_t color, uint16_t x, uint16_t y);
+void    clip_span(uint16_t color, uint16_t x, uint16_t y, uint16_t w);
+
+// text.c: the text settings, which queued strings swap in and out
+extern uint16_t cursor_x;
+extern uint16_t cursor_y;
+extern uint8_t  textmultiplier;
+extern uint16_t textcolor;
+extern uint16_t textbgcolor;
+extern bool     text_wrap;
+void draw_char_at_cursor(char chr);
+
+#endif // BG_INTERNAL_H
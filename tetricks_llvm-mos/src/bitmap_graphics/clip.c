@@ -0,0 +1,186 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/clip.c
+//
+// The clip rectangle, which every primitive is drawn through. Coordinates
+// are taken as int16_t here, so something a little off the left or top of
+// the canvas (wrapped uint16_t math) gets clipped rather than turning up
+// far to the right, or past the end of the canvas.
+// Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bg_internal.h"
+
+int16_t clip_x0 = 0;   // inclusive, and always inside the canvas
+int16_t clip_y0 = 0;
+int16_t clip_x1 = 319;
+int16_t clip_y1 = 179;
+
+// ---------------------------------------------------------------------------
+// Clip to x, y, w, h, or as much of it as is on the canvas.
+// ---------------------------------------------------------------------------
+void set_clip_rect(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    reset_clip_rect();
+    if (!clip_range(&x, &w, clip_x0, clip_x1) ||
+        !clip_range(&y, &h, clip_y0, clip_y1)) {
+        clip_x0 = clip_y0 = 1; // nothing at all gets drawn
+        clip_x1 = clip_y1 = 0;
+        return;
+    }
+    clip_x0 = x;
+    clip_y0 = y;
+    clip_x1 = x + w - 1;
+    clip_y1 = y + h - 1;
+}
+
+// ---------------------------------------------------------------------------
+// Clip to the whole canvas again.
+// ---------------------------------------------------------------------------
+void reset_clip_rect(void)
+{
+    clip_x0 = 0;
+    clip_y0 = 0;
+    clip_x1 = canvas_w - 1;
+    clip_y1 = canvas_h - 1;
+}
+
+// ---------------------------------------------------------------------------
+// Trim the run of n from *p to what lies within lo..hi, returning false if
+// none of it does. The sums are done unsigned, so they can't overflow.
+// ---------------------------------------------------------------------------
+bool clip_range(uint16_t * p, uint16_t * n, int16_t lo, int16_t hi)
+{
+    int16_t p0 = *p;
+    uint16_t skip;
+
+    if (*n == 0) {
+        return false;
+    }
+    if (p0 < lo) {
+        skip = (uint16_t)lo - (uint16_t)p0;
+        if (*n <= skip) {
+            return false;
+        }
+        *n -= skip;
+        p0 = lo;
+    }
+    if (p0 > hi) {
+        return false;
+    }
+    if (*n > (uint16_t)(hi - p0) + 1) {
+        *n = (uint16_t)(hi - p0) + 1;
+    }
+    *p = p0;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Whether the box x0..x1, y0..y1 is all outside the clip rectangle
+// (CLIP_OUT), all inside it (CLIP_IN), or across an edge (CLIP_PART).
+// ---------------------------------------------------------------------------
+uint8_t clip_box(int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+    if (x1 < clip_x0 || x0 > clip_x1 || y1 < clip_y0 || y0 > clip_y1) {
+        return CLIP_OUT;
+    }
+    if (x0 >= clip_x0 && x1 <= clip_x1 && y0 >= clip_y0 && y1 <= clip_y1) {
+        return CLIP_IN;
+    }
+    return CLIP_PART;
+}
+
+// ---------------------------------------------------------------------------
+// plot() and span(), but only what's inside the clip rectangle. For drawing
+// things that cross its edge; things inside it can skip straight to those.
+// ---------------------------------------------------------------------------
+void clip_plot(uint16_t color, uint16_t x, uint16_t y)
+{
+    if ((int16_t)x >= clip_x0 && (int16_t)x <= clip_x1 &&
+        (int16_t)y >= clip_y0 && (int16_t)y <= clip_y1) {
+        plot(color, x, y);
+    }
+}
+
+void clip_span(uint16_t color, uint16_t x, uint16_t y, uint16_t w)
+{
+    if ((int16_t)y >= clip_y0 && (int16_t)y <= clip_y1 &&
+        clip_range(&x, &w, clip_x0, clip_x1)) {
+        span(color, x, y, w);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Cohen-Sutherland: which sides of the clip rectangle x, y is beyond.
+// ---------------------------------------------------------------------------
+#define OUT_LEFT   1
+#define OUT_RIGHT  2
+#define OUT_TOP    4
+#define OUT_BOTTOM 8
+
+static uint8_t outcode(int16_t x, int16_t y)
+{
+    uint8_t code = 0;
+
+    if (x < clip_x0) {
+        code |= OUT_LEFT;
+    } else if (x > clip_x1) {
+        code |= OUT_RIGHT;
+    }
+    if (y < clip_y0) {
+        code |= OUT_TOP;
+    } else if (y > clip_y1) {
+        code |= OUT_BOTTOM;
+    }
+    return code;
+}
+
+// ---------------------------------------------------------------------------
+// Cut the line from x0, y0 to x1, y1 down to the part inside the clip
+// rectangle, returning false if there's none. Lines already inside, which
+// is most of them, come straight back without any of the long arithmetic.
+// ---------------------------------------------------------------------------
+bool clip_line(int16_t * x0, int16_t * y0, int16_t * x1, int16_t * y1)
+{
+    uint8_t code0 = outcode(*x0, *y0);
+    uint8_t code1 = outcode(*x1, *y1);
+    uint8_t code;
+    int32_t dx, dy;
+    int16_t x, y;
+
+    if (clip_x0 > clip_x1) {
+        return false; // set_clip_rect() left nothing to draw in
+    }
+    while (code0 | code1) {
+        if (code0 & code1) {
+            return false; // both beyond the same side
+        }
+        code = code0 ? code0 : code1;
+        dx = (int32_t)*x1 - *x0;
+        dy = (int32_t)*y1 - *y0;
+        if (code & OUT_TOP) {
+            y = clip_y0;
+            x = *x0 + dx * ((int32_t)y - *y0) / dy;
+        } else if (code & OUT_BOTTOM) {
+            y = clip_y1;
+            x = *x0 + dx * ((int32_t)y - *y0) / dy;
+        } else if (code & OUT_LEFT) {
+            x = clip_x0;
+            y = *y0 + dy * ((int32_t)x - *x0) / dx;
+        } else {
+            x = clip_x1;
+            y = *y0 + dy * ((int32_t)x - *x0) / dx;
+        }
+        if (code == code0) {
+            *x0 = x;
+            *y0 = y;
+            code0 = outcode(x, y);
+        } else {
+            *x1 = x;
+            *y1 = y;
+            code1 = outcode(x, y);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,270 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/palette.c
+//
+// Custom palettes in XRAM, and animating their first few colors. Changing a
+// palette entry recolors every pixel drawn in it at once, for the cost of
+// writing two bytes, where redrawing them all could take frames.
+// Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <rp6502.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "bg_internal.h"
+
+#define PAL_IDLE  0
+#define PAL_FLASH 1 // color for a while, then back
+#define PAL_PULSE 2 // fade to color and back again
+#define PAL_FADE  3 // fade to color, and stay there
+#define PAL_CYCLE 4 // rotate a run of entries, until stopped
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  index;  // entry, or first entry of a cycle
+    uint8_t  count;  // entries in a cycle
+    uint8_t  frames; // how long, or a cycle's frames per step
+    uint8_t  t;      // frames gone by
+    uint8_t  step;   // how far a cycle has turned
+    uint16_t color;  // what it flashes, pulses or fades to
+    uint16_t addr;   // the palette in XRAM, whichever canvas is in use now
+} palette_anim;
+
+// The first colors of the palette set_palette() set up last, as they were
+// set: cycles don't rotate these, so they're what stopping goes back to.
+static uint16_t     palette[PALETTE_COLORS];
+static uint16_t     palette_addr = 0xFFFF;
+static palette_anim anims[PALETTE_ANIMS];
+
+// ---------------------------------------------------------------------------
+// Write entry index of the palette at addr in XRAM. This goes through portal
+// 1, so the XRAM cursor on portal 0 carries on undisturbed.
+// ---------------------------------------------------------------------------
+static void write_entry(uint16_t addr, uint8_t index, uint16_t color)
+{
+    RIA.step1 = 1;
+    RIA.addr1 = addr + index*2;
+    RIA.rw1 = color & 0xFF;
+    RIA.rw1 = color >> 8;
+}
+
+// ---------------------------------------------------------------------------
+// Copy count colors into XRAM at addr and have the canvas use them. 4bpp
+// needs 16, and 8bpp up to 256; color(i, true) for i up to 15 gives the
+// built-in palette's first 16. Animating works on the first PALETTE_COLORS.
+// ---------------------------------------------------------------------------
+void set_palette(uint16_t addr, const uint16_t * colors, uint16_t count)
+{
+    uint16_t i;
+
+    stop_palette_anims();
+    RIA.step1 = 1;
+    RIA.addr1 = addr;
+    for (i = 0; i < count; i++) {
+        RIA.rw1 = colors[i] & 0xFF;
+        RIA.rw1 = colors[i] >> 8;
+        if (i < PALETTE_COLORS) {
+            palette[i] = colors[i];
+        }
+    }
+    palette_addr = addr;
+    use_palette(addr);
+}
+
+// ---------------------------------------------------------------------------
+// Put back the colors an animation has been changing.
+// ---------------------------------------------------------------------------
+static void restore_entries(const palette_anim * a)
+{
+    uint8_t j;
+
+    for (j = 0; j < a->count; j++) {
+        write_entry(a->addr, a->index + j, palette[a->index + j]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Change one color of the canvas's custom palette, stopping anything
+// animating it.
+// ---------------------------------------------------------------------------
+void set_palette_color(uint8_t index, uint16_t color)
+{
+    uint8_t i;
+
+    if (palette_ptr == 0xFFFF) {
+        return; // the built-in palette can't change
+    }
+    if (palette_ptr == palette_addr && index < PALETTE_COLORS) {
+        for (i = 0; i < PALETTE_ANIMS; i++) {
+            if (anims[i].type != PAL_CYCLE && anims[i].index == index) {
+                anims[i].type = PAL_IDLE;
+            }
+        }
+        palette[index] = color;
+    }
+    write_entry(palette_ptr, index, color);
+}
+
+// ---------------------------------------------------------------------------
+// Start an animation in a free slot, or the one already on the same entry.
+// Only the palette set_palette() set up last has its colors kept, so that's
+// the one the canvas has to be using.
+// ---------------------------------------------------------------------------
+static void start_anim(uint8_t type, uint8_t index, uint8_t count,
+                       uint16_t color, uint8_t frames)
+{
+    palette_anim * a = 0;
+    uint8_t i;
+
+    if (palette_ptr == 0xFFFF || palette_ptr != palette_addr ||
+        index >= PALETTE_COLORS || frames == 0) {
+        return;
+    }
+    for (i = 0; i < PALETTE_ANIMS; i++) {
+        if (anims[i].type != PAL_IDLE && anims[i].index == index) {
+            a = &anims[i];
+            restore_entries(a); // start over from its colors
+            break;
+        }
+        if (anims[i].type == PAL_IDLE && a == 0) {
+            a = &anims[i];
+        }
+    }
+    if (a == 0) {
+        return; // all busy
+    }
+    a->type = type;
+    a->index = index;
+    a->count = count;
+    a->frames = frames;
+    a->t = 0;
+    a->step = 0;
+    a->color = color;
+    a->addr = palette_addr;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void flash_palette(uint8_t index, uint16_t color, uint8_t frames)
+{
+    start_anim(PAL_FLASH, index, 1, color, frames);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void pulse_palette(uint8_t index, uint16_t color, uint8_t frames)
+{
+    start_anim(PAL_PULSE, index, 1, color, frames);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void fade_palette(uint8_t index, uint16_t color, uint8_t frames)
+{
+    start_anim(PAL_FADE, index, 1, color, frames);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void cycle_palette(uint8_t first, uint8_t count, uint8_t frames)
+{
+    if (count > PALETTE_COLORS - first) {
+        count = PALETTE_COLORS - first;
+    }
+    start_anim(PAL_CYCLE, first, count, 0, frames);
+}
+
+// ---------------------------------------------------------------------------
+// Stop every animation, and put the colors back as they were set.
+// ---------------------------------------------------------------------------
+void stop_palette_anims(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < PALETTE_ANIMS; i++) {
+        palette_anim * a = &anims[i];
+        if (a->type == PAL_FADE) {
+            palette[a->index] = a->color; // it was headed there anyway
+        }
+        if (a->type != PAL_IDLE) {
+            restore_entries(a);
+        }
+        a->type = PAL_IDLE;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// from blended t/n of the way to to, one 5-bit channel at a time. The alpha
+// bit stays from's until the end.
+// ---------------------------------------------------------------------------
+static uint16_t blend(uint16_t from, uint16_t to, uint8_t t, uint8_t n)
+{
+    uint16_t c = 0;
+    uint8_t shift;
+
+    if (t >= n) {
+        return to;
+    }
+    for (shift = 0; shift <= 11; shift += (shift == 0) ? 6 : 5) {
+        int16_t a = (from >> shift) & 31;
+        int16_t b = (to >> shift) & 31;
+        c |= (uint16_t)(a + (b - a) * t / n) << shift;
+    }
+    return c | (from & COLOR_ALPHA_MASK);
+}
+
+// ---------------------------------------------------------------------------
+// Move each animation on a frame. Call this once per vsync, as soon after
+// RIA.vsync changes as can be, so the colors change while nothing is being
+// scanned out. Returns true while any animation is still going.
+// ---------------------------------------------------------------------------
+bool animate_palette(void)
+{
+    bool busy = false;
+    uint8_t i, j, k;
+
+    for (i = 0; i < PALETTE_ANIMS; i++) {
+        palette_anim * a = &anims[i];
+        uint16_t base = palette[a->index];
+        uint8_t half = (a->frames + 1) / 2;
+
+        if (a->type == PAL_IDLE) {
+            continue;
+        }
+        a->t++;
+        switch (a->type) {
+            case PAL_FLASH:
+                write_entry(a->addr, a->index, (a->t < a->frames) ? a->color : base);
+                break;
+            case PAL_PULSE:
+                write_entry(a->addr, a->index, (a->t < half) ?
+                            blend(base, a->color, a->t, half) :
+                            blend(a->color, base, a->t - half, a->frames - half));
+                break;
+            case PAL_FADE:
+                write_entry(a->addr, a->index, blend(base, a->color, a->t, a->frames));
+                if (a->t >= a->frames) {
+                    palette[a->index] = a->color;
+                }
+                break;
+            case PAL_CYCLE: // entry j shows the color set step entries on
+                if (a->t >= a->frames) {
+                    a->t = 0;
+                    a->step = (a->step + 1 < a->count) ? a->step + 1 : 0;
+                    for (j = 0; j < a->count; j++) {
+                        k = j + a->step;
+                        if (k >= a->count) {
+                            k -= a->count;
+                        }
+                        write_entry(a->addr, a->index + j, palette[a->index + k]);
+                    }
+                }
+                break;
+        }
+        if (a->type != PAL_CYCLE && a->t >= a->frames) {
+            a->type = PAL_IDLE;
+        } else {
+            busy = true;
+        }
+    }
+    return busy;
+}
@@ -0,0 +1,87 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/rect.c
+//
+// Pixels, straight lines along the axes and rectangles.
+// Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "bg_internal.h"
+
+// ---------------------------------------------------------------------------
+// Draw a pixel on the RP6502, for all the various bpp modes.
+// ---------------------------------------------------------------------------
+void draw_pixel(uint16_t color, uint16_t x, uint16_t y)
+{
+    clip_plot(color, x, y);
+    xram_cursor_flush();
+}
+
+// ---------------------------------------------------------------------------
+// Work out the first pixel's address and mask, then step down a row at a
+// time: the same bits of the byte xram_stride further on. A line through the
+// RAM shadow is plotted instead.
+// ---------------------------------------------------------------------------
+void draw_vline(uint16_t color, uint16_t x, uint16_t y, uint16_t h)
+{
+    uint8_t mask, bits, hi;
+    uint16_t addr;
+
+    if ((int16_t)x < clip_x0 || (int16_t)x > clip_x1 ||
+        !clip_range(&y, &h, clip_y0, clip_y1)) {
+        return;
+    }
+    if (shadow_touches(x, y, x, y + h - 1)) {
+        for (; h; h--) {
+            plot(color, x, y++);
+        }
+        xram_cursor_flush();
+        return;
+    }
+    addr = pixel_addr(x, y, &mask);
+    bits = color_pattern(color) & mask;
+    hi = color_value(color) >> 8;
+    for (; h; h--) {
+        xram_plot(addr, bits, mask);
+        if (bpp_mode == 4) { // 16bpp
+            xram_plot(addr+1, hi, 0xFF);
+        }
+        addr += xram_stride;
+    }
+    xram_cursor_flush();
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void draw_hline(uint16_t color, uint16_t x, uint16_t y, uint16_t w)
+{
+    clip_span(color, x, y, w);
+    xram_cursor_flush();
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void draw_rect(uint16_t color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    draw_hline(color, x, y, w);
+    draw_hline(color, x, y+h-1, w);
+    draw_vline(color, x, y, h);
+    draw_vline(color, x+w-1, y, h);
+}
+
+// ---------------------------------------------------------------------------
+// Clip the rectangle once, and then its spans are all inside.
+// ---------------------------------------------------------------------------
+void fill_rect(uint16_t color, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    uint16_t j;
+
+    if (!clip_range(&x, &w, clip_x0, clip_x1) ||
+        !clip_range(&y, &h, clip_y0, clip_y1)) {
+        return;
+    }
+    for(j=y; j<(y+h); j++) {
+        span(color, x, j, w);
+    }
+    xram_cursor_flush();
+}
@@ -0,0 +1,268 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/shadow.c
+//
+// A RAM shadow of part of a 4bpp canvas. Drawing inside it is ordinary stores
+// into RAM, so two pixels sharing a byte don't cost an XRAM read, and each
+// row it changes is marked dirty. flush_shadow() then streams the dirty rows
+// out to XRAM with auto-increment, writes only.
+// Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <rp6502.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "bg_internal.h"
+
+static uint8_t * shadow_buf;
+static uint16_t  shadow_addr;   // XRAM address of its top left byte
+static uint16_t  shadow_stride; // bytes per row in shadow_buf
+static uint16_t  canvas_stride; // and on the canvas, for flushing from anywhere
+static uint16_t  shadow_rows;
+static uint8_t   dirty[SHADOW_ROWS/8];
+static uint16_t  dirty_rows = 0;
+static uint16_t  flush_row = 0; // where flush_shadow() carries on from
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+static void mark_dirty(uint16_t row)
+{
+    uint8_t bit = 1 << (row & 7);
+
+    if (!(dirty[row >> 3] & bit)) {
+        dirty[row >> 3] |= bit;
+        dirty_rows++;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// plot() on the shadowed canvas.
+// ---------------------------------------------------------------------------
+static void plot_shadow(uint16_t color, uint16_t x, uint16_t y)
+{
+    uint8_t * p;
+
+    if (x < shadow_x0 || x >= shadow_x1 || y < shadow_y0 || y >= shadow_y1) {
+        shadow_fallback(color, x, y);
+        return;
+    }
+    y -= shadow_y0;
+    x -= shadow_x0;
+    p = shadow_buf + shadow_stride * y + x/2;
+    if (x & 1) {
+        *p = (*p & 0xF0) | (color & 15);
+    } else {
+        *p = (*p & 0x0F) | ((color & 15) << 4);
+    }
+    mark_dirty(y);
+}
+
+// ---------------------------------------------------------------------------
+// span() inside the shadow: a nibble at either end, whole bytes between.
+// ---------------------------------------------------------------------------
+static void span_shadow(uint16_t color, uint16_t x, uint16_t y, uint16_t w)
+{
+    uint8_t pair = (color & 15) * 0x11;
+    uint8_t * p;
+
+    y -= shadow_y0;
+    x -= shadow_x0;
+    p = shadow_buf + shadow_stride * y + x/2;
+    if (x & 1) {
+        *p = (*p & 0xF0) | (pair & 0x0F);
+        p++;
+        w--;
+    }
+    memset(p, pair, w/2);
+    if (w & 1) {
+        p += w/2;
+        *p = (*p & 0x0F) | (pair & 0xF0);
+    }
+    mark_dirty(y);
+}
+
+// ---------------------------------------------------------------------------
+// draw_stamp() at addr, if the stamp is wholly inside the shadow. A stamp
+// partly inside comes back as CLIP_PART, for draw_stamp() to plot instead.
+// ---------------------------------------------------------------------------
+static uint8_t stamp_shadow(const stamp * s, uint16_t color, uint16_t addr)
+{
+    uint8_t pair = (color & 15) * 0x11;
+    uint16_t off = addr - canvas_data;
+    uint16_t y = off / xram_stride;
+    uint16_t x = (off - y * xram_stride) * 2;
+    const uint8_t * base = s->base;
+    const uint8_t * mask = s->mask;
+    uint8_t * p;
+    uint8_t i, j;
+
+    if (x + STAMP_SIZE <= shadow_x0 || x >= shadow_x1 ||
+        y + STAMP_SIZE <= shadow_y0 || y >= shadow_y1) {
+        return CLIP_OUT;
+    }
+    if (x < shadow_x0 || x + STAMP_SIZE > shadow_x1 ||
+        y < shadow_y0 || y + STAMP_SIZE > shadow_y1) {
+        return CLIP_PART;
+    }
+    y -= shadow_y0;
+    p = shadow_buf + shadow_stride * y + (x - shadow_x0)/2;
+    for (j = 0; j < STAMP_SIZE; j++) {
+        for (i = 0; i < STAMP_SIZE/2; i++) {
+            p[i] = *base++ | (pair & *mask++);
+        }
+        p += shadow_stride;
+        mark_dirty(y + j);
+    }
+    return CLIP_IN;
+}
+
+// ---------------------------------------------------------------------------
+// erase_canvas() cleared XRAM under the shadow as well, so nothing's dirty.
+// ---------------------------------------------------------------------------
+static void erase_shadow(void)
+{
+    memset(shadow_buf, 0, shadow_stride * shadow_rows);
+    memset(dirty, 0, sizeof(dirty));
+    dirty_rows = 0;
+}
+
+static const shadow_hooks hooks = {
+    plot_shadow, span_shadow, stamp_shadow, erase_shadow
+};
+
+// ---------------------------------------------------------------------------
+// Shadow w x h pixels of the canvas in use from x, y, in buf, which needs
+// SHADOW_BYTES(w, h). x and w are widened to whole bytes. What's on the
+// canvas there is read into buf once, and from then on drawing inside it on
+// this canvas goes to buf, until end_shadow(). There's one shadow at a time,
+// on a 4bpp canvas; this returns false if it can't be set up as asked.
+// ---------------------------------------------------------------------------
+bool init_shadow(uint8_t * buf, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    uint16_t x1 = (x + w + 1) & ~1;
+    uint8_t * p;
+    uint16_t i, j;
+
+    end_shadow();
+    x &= ~1;
+    if (bpp_mode != 2 || w == 0 || h == 0 || h > SHADOW_ROWS ||
+        x1 > canvas_w || y + h > canvas_h) {
+        return false;
+    }
+    shadow_buf = buf;
+    shadow_x0 = x;
+    shadow_y0 = y;
+    shadow_x1 = x1;
+    shadow_y1 = y + h;
+    shadow_stride = (x1 - x) / 2;
+    shadow_rows = h;
+    canvas_stride = xram_stride;
+    shadow_addr = canvas_data + xram_stride * y + x/2;
+
+    xram_cursor_flush();
+    RIA.step0 = 1;
+    p = buf;
+    for (j = 0; j < h; j++) {
+        RIA.addr0 = shadow_addr + canvas_stride * j;
+        for (i = 0; i < shadow_stride; i++) {
+            *p++ = RIA.rw0;
+        }
+    }
+    xram_cursor_invalidate();
+    memset(dirty, 0, sizeof(dirty));
+    dirty_rows = 0;
+    flush_row = 0;
+
+    shadow = &hooks;
+    shadow_canvas = active_canvas;
+    shadow_fallback = plot;
+    plot = plot_shadow;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Flush the whole shadow and go back to drawing straight to XRAM there.
+// ---------------------------------------------------------------------------
+void end_shadow(void)
+{
+    if (shadow_canvas == 0) {
+        return;
+    }
+    while (flush_shadow(0xFFFF)) {
+    }
+    if (shadow_canvas == active_canvas) {
+        plot = shadow_fallback;
+    } else {
+        shadow_canvas->plot = shadow_fallback; // put away by use_canvas()
+    }
+    shadow_canvas = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Bytes of RAM the shadow takes, 0 without one.
+// ---------------------------------------------------------------------------
+uint16_t shadow_size(void)
+{
+    return (shadow_canvas != 0) ? shadow_stride * shadow_rows : 0;
+}
+
+// ---------------------------------------------------------------------------
+// How many rows are waiting to be flushed.
+// ---------------------------------------------------------------------------
+uint16_t shadow_dirty_rows(void)
+{
+    return (shadow_canvas != 0) ? dirty_rows : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Whether canvas row y is waiting to be flushed.
+// ---------------------------------------------------------------------------
+bool shadow_row_dirty(uint16_t y)
+{
+    if (shadow_canvas == 0 || y < shadow_y0 || y >= shadow_y1) {
+        return false;
+    }
+    y -= shadow_y0;
+    return (dirty[y >> 3] & (1 << (y & 7))) != 0;
+}
+
+// ---------------------------------------------------------------------------
+// Write dirty rows out to XRAM, going on round from where the last flush
+// stopped, until budget bytes are spent. At least one row goes, however
+// small the budget. Returns how many rows are still dirty.
+// ---------------------------------------------------------------------------
+uint16_t flush_shadow(uint16_t budget)
+{
+    uint16_t spent = 0;
+    uint16_t n, i;
+    const uint8_t * p;
+
+    if (shadow_canvas == 0 || dirty_rows == 0) {
+        return 0;
+    }
+    xram_cursor_flush();
+    RIA.step0 = 1;
+    for (n = shadow_rows; n && dirty_rows; n--) {
+        uint16_t row = flush_row;
+        uint8_t bit = 1 << (row & 7);
+
+        if (dirty[row >> 3] & bit) {
+            if (spent > 0 && (spent >= budget || shadow_stride > budget - spent)) {
+                break; // carry the rest over
+            }
+            dirty[row >> 3] &= ~bit;
+            dirty_rows--;
+            RIA.addr0 = shadow_addr + canvas_stride * row;
+            p = shadow_buf + shadow_stride * row;
+            for (i = 0; i < shadow_stride; i++) {
+                RIA.rw0 = *p++;
+            }
+            spent += shadow_stride;
+        }
+        if (++flush_row == shadow_rows) {
+            flush_row = 0;
+        }
+    }
+    xram_cursor_invalidate();
+    return dirty_rows;
+}
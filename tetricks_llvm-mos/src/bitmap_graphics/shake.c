@@ -0,0 +1,90 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/shake.c
+//
+// Shaking and nudging the whole canvas, by moving where it's shown rather
+// than anything drawn on it. Each frame costs one offset_canvas().
+// Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bg_internal.h"
+
+// Damped oscillations, as 1/128ths of the full offset, over SHAKE_STEPS
+// steps of however many frames the effect lasts. A shake swings to and fro
+// every four steps; a nudge springs back once and settles.
+#define SHAKE_STEPS 16
+
+static const int8_t shake_curve[SHAKE_STEPS] = {
+    127, 0, -82, 0, 53, 0, -34, 0, 22, 0, -14, 0, 9, 0, -6, 0
+};
+static const int8_t nudge_curve[SHAKE_STEPS] = {
+    127, 85, 31, -13, -37, -42, -32, -15, 0, 10, 13, 11, 7, 1, -2, -4
+};
+
+static const int8_t * shake_table = 0; // 0 when the canvas is still
+static int8_t  shake_dx;
+static int8_t  shake_dy;
+static uint8_t shake_frames;
+static uint8_t shake_t;
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+static void start_shake(const int8_t * table, int8_t dx, int8_t dy, uint8_t frames)
+{
+    if (frames == 0) {
+        return;
+    }
+    shake_table = table;
+    shake_dx = dx;
+    shake_dy = dy;
+    shake_frames = frames;
+    shake_t = 0;
+    offset_canvas(dx, dy);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void shake_canvas(int8_t dx, int8_t dy, uint8_t frames)
+{
+    start_shake(shake_curve, dx, dy, frames);
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void nudge_canvas(int8_t dx, int8_t dy, uint8_t frames)
+{
+    start_shake(nudge_curve, dx, dy, frames);
+}
+
+// ---------------------------------------------------------------------------
+// Put the canvas straight back where it belongs.
+// ---------------------------------------------------------------------------
+void stop_shake(void)
+{
+    if (shake_table != 0) {
+        shake_table = 0;
+        offset_canvas(0, 0);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Move the canvas on a frame. Call this once per vsync, right after RIA.vsync
+// changes, so it moves between one frame being scanned out and the next.
+// Returns true while it's still moving.
+// ---------------------------------------------------------------------------
+bool animate_shake(void)
+{
+    int16_t k;
+
+    if (shake_table == 0) {
+        return false;
+    }
+    if (++shake_t >= shake_frames) {
+        stop_shake();
+        return false;
+    }
+    k = shake_table[(uint16_t)shake_t * SHAKE_STEPS / shake_frames];
+    offset_canvas(shake_dx * k / 128, shake_dy * k / 128);
+    return true;
+}
@@ -0,0 +1,171 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/stamp.c
+//
+// Block stamps and compiled sprites.
+// Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <rp6502.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "bg_internal.h"
+
+// ---------------------------------------------------------------------------
+// XRAM address of pixel x, y in the current mode, for draw_stamp()
+// ---------------------------------------------------------------------------
+uint16_t stamp_address(uint16_t x, uint16_t y)
+{
+    uint8_t bpp = bpp_mode_to_bpp[bpp_mode];
+    return canvas_data + (canvas_w*bpp/8) * y + x*bpp/8;
+}
+
+#ifdef XRAM_ASM
+void xram_stamp_rows(const stamp * s, uint8_t pair, uint16_t addr);
+#else
+#ifdef XRAM_INLINE_ASM
+#if (STAMP_SIZE != 8)
+    #error "rw0_stamp_row() writes 4 bytes a row"
+#endif
+// ---------------------------------------------------------------------------
+// Write one stamp row, base[i] | (pair & mask[i]) for each of its 4 bytes,
+// to RIA.rw0.
+// ---------------------------------------------------------------------------
+static void rw0_stamp_row(const uint8_t * base, const uint8_t * mask, uint8_t pair)
+{
+    __asm__ volatile (
+        "   ldy #0\n"
+        "   lda (%1),y\n"
+        "   and %2\n"
+        "   ora (%0),y\n"
+        "   sta $ffe4\n"
+        "   iny\n"
+        "   lda (%1),y\n"
+        "   and %2\n"
+        "   ora (%0),y\n"
+        "   sta $ffe4\n"
+        "   iny\n"
+        "   lda (%1),y\n"
+        "   and %2\n"
+        "   ora (%0),y\n"
+        "   sta $ffe4\n"
+        "   iny\n"
+        "   lda (%1),y\n"
+        "   and %2\n"
+        "   ora (%0),y\n"
+        "   sta $ffe4\n"
+        :
+        : "r" (base), "r" (mask), "r" (pair)
+        : "a", "y", "memory");
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Write a 4bpp stamp's rows at addr, xram_stride bytes apart: each byte is
+// base | (pair & mask), with RIA.step0 left at 1.
+// ---------------------------------------------------------------------------
+static void xram_stamp_rows(const stamp * s, uint8_t pair, uint16_t addr)
+{
+    const uint8_t * base = s->base;
+    const uint8_t * mask = s->mask;
+    uint8_t j;
+#ifndef XRAM_INLINE_ASM
+    uint8_t i;
+#endif
+
+    RIA.step0 = 1;
+    for (j = 0; j < STAMP_SIZE; j++) {
+        RIA.addr0 = addr;
+#ifdef XRAM_INLINE_ASM
+        rw0_stamp_row(base, mask, pair);
+        base += STAMP_SIZE/2;
+        mask += STAMP_SIZE/2;
+#else
+        for (i = 0; i < STAMP_SIZE/2; i++) {
+            RIA.rw0 = *base++ | (pair & *mask++);
+        }
+#endif
+        addr += xram_stride;
+    }
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Stamp a STAMP_SIZE square pattern at a stamp_address(). In 4bpp each row
+// goes out as STAMP_SIZE/2 whole bytes with auto-increment, base bits with
+// the color's nibbles merged in where mask is set. Other modes fall back to
+// plotting it, and there the address has to start a byte.
+// A stamp all outside the clip rectangle is dropped, and one across its edge
+// is plotted through it. With the clip rectangle at the whole canvas, a 4bpp
+// stamp is only checked by address, to be on the canvas as a whole, which
+// saves working out x and y.
+// A stamp inside the RAM shadow goes there, and one across its edge is
+// plotted, so each pixel lands on the right side of it.
+// ---------------------------------------------------------------------------
+void draw_stamp(const stamp * s, uint16_t color, uint16_t addr)
+{
+    uint8_t shadowed = SHADOWED() ? shadow->stamp(s, color, addr) : CLIP_OUT;
+    uint8_t clip = CLIP_IN;
+    uint8_t bpp = bpp_mode_to_bpp[bpp_mode];
+    uint16_t x, y;
+    uint8_t i, j;
+
+    if (shadowed == CLIP_IN) {
+        return;
+    }
+    if (bpp_mode != 2 || shadowed != CLIP_OUT || !CLIP_IS_CANVAS()) {
+        uint16_t stride = canvas_w*bpp/8;
+        x = (addr - canvas_data) % stride * 8 / bpp;
+        y = (addr - canvas_data) / stride;
+        clip = clip_box(x, y, x+STAMP_SIZE-1, y+STAMP_SIZE-1);
+        if (clip == CLIP_OUT) {
+            return;
+        }
+    }
+    if (bpp_mode == 2 && shadowed == CLIP_OUT && clip == CLIP_IN) { // 4bpp
+        uint16_t bytes = (STAMP_SIZE-1)*xram_stride + STAMP_SIZE/2;
+        if (addr < canvas_data || addr - canvas_data > canvas_bytes - bytes) {
+            return;
+        }
+        xram_cursor_flush();
+        xram_stamp_rows(s, (color & 15) * 0x11, addr);
+        xc_valid = true;
+        xc_step = 1;
+        xc_addr = addr + bytes;
+    } else {
+        void (*pixel)(uint16_t color, uint16_t x, uint16_t y) =
+            (clip == CLIP_IN) ? plot : clip_plot;
+
+        for (j = 0; j < STAMP_SIZE; j++) {
+            for (i = 0; i < STAMP_SIZE; i++) {
+                uint8_t n = j*(STAMP_SIZE/2) + i/2;
+                uint8_t shift = (i & 1) ? 0 : 4;
+                uint8_t base = (s->base[n] >> shift) & 15;
+                uint8_t mask = (s->mask[n] >> shift) & 15;
+                if (bpp_mode == 2) { // merged as xram_stamp_rows() does
+                    pixel(base | (color & mask), x+i, y+j);
+                } else if (mask) {
+                    pixel(color, x+i, y+j);
+                } else {
+                    pixel(base, x+i, y+j);
+                }
+            }
+        }
+        xram_cursor_flush();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Run a compiled sprite at addr. It moves RIA.addr0 about on its own, so the
+// XRAM cursor has to start over afterwards. Only where it starts is known
+// here, so that's all that can be checked against the canvas.
+// ---------------------------------------------------------------------------
+void draw_sprite(sprite_fn fn, uint16_t addr)
+{
+    if (addr < canvas_data || addr - canvas_data >= canvas_bytes) {
+        return;
+    }
+    xram_cursor_flush();
+    RIA.step0 = 1;
+    fn(addr);
+    xc_valid = false;
+}
@@ -0,0 +1,223 @@
+// ---------------------------------------------------------------------------
+// bitmap_graphics/text.c
+//
+// Text in the 5x7 font. Part of the bitmap_graphics library, see canvas.c.
+// ---------------------------------------------------------------------------
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "font5x7_rows.h" // font5x7.h subset, generated by tools/font5x7.py
+#include "bg_internal.h"
+
+uint16_t cursor_y = 0;
+uint16_t cursor_x = 0;
+uint8_t  textmultiplier = 1;
+uint16_t textcolor = 15;
+uint16_t textbgcolor = 15;
+bool     text_wrap = true;
+
+// Largest textmultiplier the packed 4bpp glyph path handles, and the most
+// bytes one scaled glyph row can cover (an odd x costs one more).
+#define GLYPH_MULT_MAX 8
+#define GLYPH_SPAN_MAX (6*GLYPH_MULT_MAX/2 + 1)
+
+// ---------------------------------------------------------------------------
+// Set cursor for text to be printed
+// ---------------------------------------------------------------------------
+void set_cursor(uint16_t x, uint16_t y)
+{
+    cursor_x = x;
+    cursor_y = y;
+}
+
+// ---------------------------------------------------------------------------
+// Set multiplier of text to be displayed (1 for 5x7, 2 for 10x14, etc...)
+// ---------------------------------------------------------------------------
+void set_text_multiplier(uint8_t mult)
+{
+    textmultiplier = (mult > 0) ? mult : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Set colors of text to be displayed.
+//     For 'transparent' background, we'll set the bg
+//     to the same as fg instead of using a flag
+// ---------------------------------------------------------------------------
+void set_text_color(uint16_t color)
+{
+    textcolor = textbgcolor = color;
+}
+
+// ---------------------------------------------------------------------------
+// Set colors of text to be displayed
+//      color = color of text
+//      background = color of text background
+// ---------------------------------------------------------------------------
+void set_text_colors(uint16_t color, uint16_t background)
+{
+    textcolor   = color;
+    textbgcolor = background;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+void set_text_wrap(bool w)
+{
+    text_wrap = w;
+}
+
+// ---------------------------------------------------------------------------
+// Draw a glyph in 4bpp, a scanline at a time. Each glyph row is expanded into
+// the packed bytes it covers, with every pixel repeated textmultiplier times,
+// and that span is then written out textmultiplier times. With a transparent
+// background only the foreground nibbles are masked in.
+// ---------------------------------------------------------------------------
+static void blit_glyph_4bpp(const uint8_t * rows, uint16_t x, uint16_t y)
+{
+    uint8_t bits[GLYPH_SPAN_MAX];
+    uint8_t mask[GLYPH_SPAN_MAX];
+    uint8_t fg = textcolor & 15;
+    uint8_t bg = textbgcolor & 15;
+    bool opaque = (textbgcolor != textcolor);
+    uint8_t m = textmultiplier;
+    uint8_t len = ((x & 1) + 6*m + 1) / 2;
+    uint16_t addr = canvas_data + xram_stride * y + x/2;
+    uint8_t i, j, k, n, p;
+
+    for (j = 0; j < 8; j++) {
+        uint8_t row = rows[j];
+
+        for (n = 0; n < len; n++) {
+            bits[n] = mask[n] = 0;
+        }
+        p = x & 1; // nibble within the span, even ones are high nibbles
+        for (i = 0; i < 6; i++, row <<= 1) {
+            uint8_t c;
+            if (row & 0x80) {
+                c = fg;
+            } else if (opaque) {
+                c = bg;
+            } else {
+                p += m; // transparent background
+                continue;
+            }
+            for (k = 0; k < m; k++, p++) {
+                if (p & 1) {
+                    bits[p >> 1] |= c;
+                    mask[p >> 1] |= 0x0F;
+                } else {
+                    bits[p >> 1] |= c << 4;
+                    mask[p >> 1] |= 0xF0;
+                }
+            }
+        }
+        for (k = 0; k < m; k++) {
+            for (n = 0; n < len; n++) {
+                if (mask[n]) {
+                    xram_plot(addr + n, bits[n], mask[n]);
+                }
+            }
+            addr += xram_stride;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Draw a character at x, y, leaving its last byte pending in the XRAM cursor
+// so the next character on the same line can share it. Only a character
+// across an edge of the clip rectangle gets each pixel checked.
+// ---------------------------------------------------------------------------
+static void put_char(char chr, uint16_t x, uint16_t y)
+{
+    const uint8_t * rows = font_rows; // blank, for chars not in the font
+    uint8_t c = (uint8_t)chr - FONT_ROWS_FIRST;
+    void (*pixel)(uint16_t color, uint16_t x, uint16_t y);
+    uint8_t i, j, clip;
+
+    clip = clip_box(x, y, x + 6*textmultiplier - 1, y + 8*textmultiplier - 1);
+    if (clip == CLIP_OUT) {
+        return;
+    }
+    pixel = (clip == CLIP_IN) ? plot : clip_plot;
+
+    if (c <= FONT_ROWS_LAST - FONT_ROWS_FIRST) {
+        rows += font_index[c] * 8;
+    }
+
+    if (bpp_mode == 2 && textmultiplier <= GLYPH_MULT_MAX && clip == CLIP_IN &&
+        !shadow_touches(x, y, x + 6*textmultiplier - 1, y + 8*textmultiplier - 1)) {
+        blit_glyph_4bpp(rows, x, y);
+        return;
+    }
+
+    // row by row, so the XRAM cursor can merge and stream each scanline
+    for (j = 0; j<8; j++) {
+        uint8_t my;
+        for (my = 0; my < textmultiplier; my++) {
+            uint8_t line = pgm_read_byte(rows+j);
+            for (i = 0; i<6; i++, line <<= 1) {
+                uint16_t color;
+                uint8_t mx;
+
+                if (line & 0x80) {
+                    color = textcolor;
+                } else if (textbgcolor != textcolor) {
+                    color = textbgcolor;
+                } else {
+                    continue; // transparent background
+                }
+                for (mx = 0; mx < textmultiplier; mx++) {
+                    pixel(color, x+(i*textmultiplier)+mx, y+(j*textmultiplier)+my);
+                }
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Draw a character at x, y
+// ---------------------------------------------------------------------------
+void draw_char(char chr, uint16_t x, uint16_t y)
+{
+    put_char(chr, x, y);
+    xram_cursor_flush();
+}
+
+// ---------------------------------------------------------------------------
+// Draw a character at cursor_x, cursor_y, then advance the cursor.
+// Whatever calls this must call xram_cursor_flush() when it's done.
+// ---------------------------------------------------------------------------
+void draw_char_at_cursor(char chr)
+{
+    if (chr == '\n') {
+        cursor_y += textmultiplier*8;
+        cursor_x  = 0;
+    } else if (chr == '\r') {
+        // skip em
+    } else if (chr == '\t') {
+        uint16_t new_x = cursor_x + TABSPACE;
+
+        if (new_x < canvas_w) {
+            cursor_x = new_x;
+        }
+    } else {
+        put_char(chr, cursor_x, cursor_y);
+        cursor_x += textmultiplier*6;
+
+        if (text_wrap && (cursor_x > (canvas_w - textmultiplier*6))) {
+            cursor_y += textmultiplier*8;
+            cursor_x = 0;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Draw a zero-terminated string at cursor_x, cursor_y, then advance the cursor.
+// ---------------------------------------------------------------------------
+void draw_string(char * str)
+{
+    while (*str) {
+        draw_char_at_cursor(*str++);
+    }
+    xram_cursor_flush();
+}
@@ -0,0 +1,89 @@
+// ---------------------------------------------------------------------------
+// rng.c
+//
+// A small seedable random number generator, and a bag randomizer on it.
+// See rng.h for what each returns.
+// ---------------------------------------------------------------------------
+
+#include <stdint.h>
+#include "rng.h"
+
+static uint16_t state = 1;       // never 0, which xorshift can't leave
+static uint8_t  bag[BAG_SIZE];
+static uint8_t  bag_left = 0;    // still to be dealt, from the end of bag[]
+
+// ---------------------------------------------------------------------------
+// Starts the sequence again from seed, with an empty bag. A seed of 0 is
+// taken as 1.
+// ---------------------------------------------------------------------------
+void rng_seed(uint16_t seed)
+{
+    state = seed ? seed : 1;
+    bag_left = 0;
+}
+
+// ---------------------------------------------------------------------------
+// A 16-bit xorshift (7, 9, 8), which goes through all 65535 nonzero values
+// before it repeats.
+// ---------------------------------------------------------------------------
+uint16_t rng_next(void)
+{
+    state ^= state << 7;
+    state ^= state >> 9;
+    state ^= state << 8;
+    return state;
+}
+
+// ---------------------------------------------------------------------------
+// A number from 0 to n-1, or 0 if n is 0, by masking and throwing away
+// any too big, which needs no division and keeps them all equally likely.
+// The mask covers n-1, so at worst (n one more than a power of two) about
+// half the draws are thrown away.
+// ---------------------------------------------------------------------------
+uint8_t rng_below(uint8_t n)
+{
+    uint8_t mask = n - 1;
+    uint8_t r;
+
+    if (n == 0) {
+        return 0; // nothing would ever be below it
+    }
+    mask |= mask >> 1;
+    mask |= mask >> 2;
+    mask |= mask >> 4;
+    do {
+        r = (uint8_t)(rng_next() >> 8) & mask; // the high bits mix better
+    } while (r >= n);
+    return r;
+}
+
+// ---------------------------------------------------------------------------
+// Empties the bag, so the next bag_next() starts a fresh one.
+// ---------------------------------------------------------------------------
+void bag_reset(void)
+{
+    bag_left = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Deals the next value from the bag. An empty bag is refilled with one of
+// each value and shuffled (Fisher-Yates) first.
+// ---------------------------------------------------------------------------
+uint8_t bag_next(void)
+{
+    uint8_t i, j, t;
+
+    if (bag_left == 0) {
+        for (i = 0; i < BAG_SIZE; i++) {
+            bag[i] = i;
+        }
+        for (i = BAG_SIZE - 1; i > 0; i--) {
+            j = rng_below(i + 1);
+            t = bag[i];
+            bag[i] = bag[j];
+            bag[j] = t;
+        }
+        bag_left = BAG_SIZE;
+    }
+    return bag[--bag_left];
+}
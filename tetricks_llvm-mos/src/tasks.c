@@ -0,0 +1,85 @@
+// ---------------------------------------------------------------------------
+// tasks.c
+//
+// A tiny cooperative task scheduler for an RP6502 game loop.
+// See tasks.h for how tasks, slices and protothreads fit together.
+// ---------------------------------------------------------------------------
+
+#include <rp6502.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "tasks.h"
+
+static uint8_t frame_vsync = 0;  // RIA.vsync value the current frame started at
+static uint8_t elapsed = 1;      // vsyncs since the previous frame started
+static uint8_t worst_frames = 0; // worst case of elapsed so far
+
+// ---------------------------------------------------------------------------
+// Call once before the game loop, so setup time doesn't count as a late frame.
+// ---------------------------------------------------------------------------
+void tasks_init(void)
+{
+    frame_vsync = RIA.vsync;
+    elapsed = 1;
+    worst_frames = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Busy-waits for the next RIA.vsync tick, then starts a new frame.
+// Returns the number of vsyncs since the last frame started, which is more
+// than 1 when the previous frame overran.
+// ---------------------------------------------------------------------------
+uint8_t tasks_wait_vsync(void)
+{
+    uint8_t v;
+    while ((v = RIA.vsync) == frame_vsync) {
+        ; // wait until vsync is incremented
+    }
+    elapsed = v - frame_vsync;
+    frame_vsync = v;
+    if (elapsed > worst_frames) {
+        worst_frames = elapsed;
+    }
+    return elapsed;
+}
+
+// ---------------------------------------------------------------------------
+// True once this frame has used up its vsync period, or if the previous one
+// overran, which is when deferrable tasks should make way.
+// ---------------------------------------------------------------------------
+bool tasks_late(void)
+{
+    return (elapsed > 1) || (RIA.vsync != frame_vsync);
+}
+
+// ---------------------------------------------------------------------------
+// Runs one frame's worth of tasks, in table (priority) order.
+// ---------------------------------------------------------------------------
+void tasks_run(task *tasks, uint8_t num_tasks)
+{
+    uint8_t i, slices;
+    for (i = 0; i < num_tasks; i++) {
+        if ((tasks[i].flags & TASK_DEFERRABLE) && tasks_late()) {
+            continue; // it'll catch up next frame
+        }
+        for (slices = 1; tasks[i].fn() == TASK_BUSY; slices++) {
+            if (slices >= tasks[i].max_slices || RIA.vsync != frame_vsync) {
+                break; // out of slices, or out of frame
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+uint8_t tasks_elapsed(void)
+{
+    return elapsed;
+}
+
+// ---------------------------------------------------------------------------
+// ---------------------------------------------------------------------------
+uint8_t tasks_worst_frames(void)
+{
+    return worst_frames;
+}
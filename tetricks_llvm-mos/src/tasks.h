@@ -0,0 +1,57 @@
+// ---------------------------------------------------------------------------
+// tasks.h
+//
+// A tiny cooperative task scheduler for an RP6502 game loop.
+//
+// Each frame, right after the RIA.vsync counter ticks, tasks_run() calls the
+// tasks in table order, so put the most important ones (input, gravity) first.
+// A task does one bounded slice of work per call and returns TASK_BUSY if it
+// has more to do, or TASK_IDLE when it's done for now. A busy task is called
+// again, up to max_slices times a frame, as long as the frame hasn't run out.
+// Time is only measured by the RIA.vsync counter, a frame at a time, so a
+// task's share of the frame is set by how big its slices are, not in cycles.
+// Tasks flagged TASK_DEFERRABLE (HUD, previews, sound) are skipped entirely
+// once a frame is running late, and simply catch up next time.
+//
+// The PT_ macros turn a task into a protothread, so that a multi-frame job
+// can be written as straight-line code that yields between slices. Locals do
+// not survive a yield, so keep the state in statics.
+// ---------------------------------------------------------------------------
+
+#ifndef TASKS_H
+#define TASKS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TASK_IDLE 0 // nothing (more) to do this frame
+#define TASK_BUSY 1 // did a slice, and there is more pending
+
+#define TASK_DEFERRABLE 0x01 // skip when the frame is running late
+
+typedef uint8_t (*task_fn)(void);
+
+typedef struct {
+    task_fn fn;
+    uint8_t max_slices; // calls per frame at most, while it's busy
+    uint8_t flags;
+} task;
+
+// protothread continuation, the source line to resume at (0 = start)
+typedef uint16_t pt_t;
+
+#define PT_INIT(pt)   (*(pt) = 0)
+#define PT_BEGIN(pt)  switch (*(pt)) { case 0:
+#define PT_YIELD(pt)  do { *(pt) = __LINE__; return TASK_BUSY; case __LINE__:; } while (0)
+#define PT_WAIT_UNTIL(pt, cond) \
+    do { *(pt) = __LINE__; case __LINE__: if (!(cond)) { return TASK_IDLE; } } while (0)
+#define PT_END(pt)    } *(pt) = 0; return TASK_IDLE
+
+void tasks_init(void);
+uint8_t tasks_wait_vsync(void);
+void tasks_run(task *tasks, uint8_t num_tasks);
+bool tasks_late(void);
+uint8_t tasks_elapsed(void);
+uint8_t tasks_worst_frames(void);
+
+#endif // TASKS_H
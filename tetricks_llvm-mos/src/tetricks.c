@@ -13,22 +13,23 @@
 
 #include <rp6502.h>
 #include <stdio.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include "usb_hid_keys.h"
 #include "colors.h"
 #include "bitmap_graphics.h"
+#include "tasks.h"
+#include "rng.h"
+#include "xram_map.h"
+#ifdef COMPILED_SPRITES
+#include "shape_sprites.h" // generated by tools/shape_sprites.py
+#endif
 
-#define CANVAS_W 320
-#define CANVAS_H 240 // 180 or 240
-
-// XRAM locations
-#define KEYBOARD_INPUT 0xFF10 // KEYBOARD_BYTES of bitmask data
+// CANVAS_W, CANVAS_H and where everything goes in XRAM are in xram_map.h
 
 // 256 bytes HID code max, stored in 32 uint8
-#define KEYBOARD_BYTES 32
 uint8_t keystates[KEYBOARD_BYTES] = {0};
 
 // keystates[code>>3] gets contents from correct byte in array
@@ -53,6 +54,40 @@ const int16_t field_h = (BLOCKS_H*BLOCK_SIZE);
 // saves color of block, if any, at field[x][y]
 static uint16_t field[BLOCKS_W][BLOCKS_H];
 
+#ifdef SURVIVAL
+// Survival: every so often the stack is pushed up a row from the bottom by a
+// row of garbage, with one gap in it. The field is drawn on a canvas of its
+// own on plane 1, as tall as the screen and wrapped vertically, so pushing
+// the stack up means showing that canvas a row higher and drawing just the
+// new bottom row, however tall the stack is.
+#ifdef COMPILED_SPRITES
+    #error "Compiled sprites can't draw across the wrapped field canvas"
+#endif
+#if (FIELD_CANVAS_W != BLOCKS_W*BLOCK_SIZE)
+    #error "xram_map.h has the field canvas the wrong width"
+#endif
+#define FIELD_ROWS     (CANVAS_H/BLOCK_SIZE) // cell rows on the field canvas
+#define GARBAGE_COLOR  LIGHT_GRAY
+#define RISE_FRAMES    600 // between garbage rows at level 1
+#define RISE_PER_LEVEL 24  // and this many frames sooner for each level up
+static bitmap_canvas * screen_canvas; // the default one
+static bitmap_canvas field_canvas;
+static uint8_t  field_top = 0;   // field canvas cell row that is field row 0
+static uint16_t rise_frames = 0; // until the next garbage row
+static bool     rising = false;  // a garbage row is queued, the canvas not moved yet
+#define ON_FIELD()  use_canvas(&field_canvas)
+#define ON_SCREEN() use_canvas(screen_canvas)
+#define RISING()    rising
+#define FIELD_ROW_X     0 // where field rows are, on the canvas they're on
+#define FIELD_ROW_Y(r)  (((field_top + (r)) % FIELD_ROWS) * BLOCK_SIZE)
+#else
+#define ON_FIELD()
+#define ON_SCREEN()
+#define RISING()    false
+#define FIELD_ROW_X     field_x
+#define FIELD_ROW_Y(r)  (field_y + (r)*BLOCK_SIZE)
+#endif
+
 // where to draw stuff
 const uint8_t keys_x = CANVAS_W/8;
 const uint8_t keys_y = CANVAS_H/5;
@@ -71,7 +106,7 @@ typedef struct {
     uint16_t blocks[4];
 } shape;
 
-static shape shapes[] = {
+static shape shapes[] = { // BAG_SIZE of them, dealt by bag_next()
     {WHITE, // 0: white bar
         {0b0010001000100010,  //   0
          0b0000111100000000,  //  90
@@ -114,69 +149,257 @@ typedef enum {AXIS_X, AXIS_Y, AXIS_Z} move_axis;
 static uint8_t next_shape = 0;
 static uint8_t current_shape = 0;
 static uint8_t current_rotation = 0;
-static uint8_t current_x = 0;
-static uint8_t current_y = 0;
+static int8_t current_col = 0; // field cell of the shape's top left corner
+static int8_t current_row = 0;
+
+// Blocks are stamped straight into XRAM, at addresses worked out up front:
+// the left cell of each field row and of each NEXT: preview row, and the
+// offset of each field column from it.
+#if (BLOCK_SIZE != STAMP_SIZE)
+    #error "BLOCK_SIZE has to match the block stamps"
+#endif
+static uint16_t field_rows[BLOCKS_H];
+static uint16_t preview_rows[4];
+static uint8_t  cell_cols[BLOCKS_W];
+static uint16_t dot_row; // offset of the row of grid dots from the cell's top
+
+#ifdef COMPILED_SPRITES
+// Falling shapes are drawn by generated code instead, in 4bpp.
+#if (SHAPE_SPRITE_STRIDE != CANVAS_W/2)
+    #error "shape_sprites.c was generated for another canvas width"
+#endif
+static bool use_sprites = false;
+#endif
+
+// A block is an outline in its color, leaving the grid dot and the gap to the
+// next cell showing, so BLACK erases it. The preview has no grid dots.
+static const stamp block_stamp = {
+    {0x00, 0x00, 0x00, 0x00,
+     0x00, 0x00, 0x00, 0x00,
+     0x00, 0x00, 0x00, 0x00,
+     0x00, DARK_GRAY, 0x00, 0x00,
+     0x00, 0x00, 0x00, 0x00,
+     0x00, 0x00, 0x00, 0x00,
+     0x00, 0x00, 0x00, 0x00,
+     0x00, 0x00, 0x00, 0x00},
+    {0xFF, 0xFF, 0xFF, 0xF0,
+     0xF0, 0x00, 0x00, 0xF0,
+     0xF0, 0x00, 0x00, 0xF0,
+     0xF0, 0x00, 0x00, 0xF0,
+     0xF0, 0x00, 0x00, 0xF0,
+     0xF0, 0x00, 0x00, 0xF0,
+     0xFF, 0xFF, 0xFF, 0xF0,
+     0x00, 0x00, 0x00, 0x00}
+};
+static const stamp preview_stamp = {
+    {0},
+    {0xFF, 0xFF, 0xFF, 0xF0,
+     0xF0, 0x00, 0x00, 0xF0,
+     0xF0, 0x00, 0x00, 0xF0,
+     0xF0, 0x00, 0x00, 0xF0,
+     0xF0, 0x00, 0x00, 0xF0,
+     0xF0, 0x00, 0x00, 0xF0,
+     0xFF, 0xFF, 0xFF, 0xF0,
+     0x00, 0x00, 0x00, 0x00}
+};
 
 // level is increased every 10 points
 static uint16_t current_level = 1;
-static uint16_t current_score = 0;
 
-// timer_threshold = 70-10*level
-// start dropping rate at once per second
-static uint8_t timer_threshold = 60;
+// The score and level are kept in packed BCD for the HUD, 4 digits at most,
+// along with what its character cells show right now.
+#define MAX_SCORE_BCD 0x9999
+static uint16_t score_bcd = 0;
+static uint8_t  level_bcd = 0x01;
+static char score_cells[4] = {' ', ' ', ' ', ' '};
+static char level_cells[4] = {' ', ' ', ' ', ' '};
+#ifdef __CC65__
+static uint8_t bcd_points; // add_score() operands, for the inline asm
+static uint8_t bcd_carry;
+#endif
+
+// Gravity is 8.8 fixed point rows per frame, so GRAVITY_1G is one row every
+// frame. Levels 1-15 follow the usual (0.8-(level-1)*0.007)^(level-1) seconds
+// per row curve, starting at once per second, then 16-20 ramp up to 20G.
+#define MAX_LEVEL     20
+#define MAX_LEVEL_BCD 0x20
+#define GRAVITY_1G    256
+#define GRAVITY_20G   (20*GRAVITY_1G)
+static const uint16_t gravity_table[MAX_LEVEL+1] = {
+       0,    4,    5,    7,    9,   12,   16,   22,   32,   45,   67, //  0-10
+      99,  151,  235,  373,  604, 1024, 1536, 2560, 3840, GRAVITY_20G  // 11-20
+};
+static uint16_t gravity_accum = 0; // fractional rows carried between frames
+static uint8_t gravity_owed = 0;    // frames the draw queue had no room for
+
+// Frames a landed shape may still slide before it locks, so high gravity
+// levels stay playable. Any successful drop starts the count again.
+#define LOCK_DELAY 30
+static uint8_t lock_frames = 0;
+
+// A line clear is redrawn a few rows per frame instead of all at once,
+// so the keyboard and timer keep being serviced while it's in progress.
+#define CLEAR_ROWS_PER_TICK 2
+static bool clearing = false;
+static bool rows_moved = false;
+static pt_t clear_pt;
+static uint8_t clear_row = 0; // next field row to redraw, working upward
+static uint8_t clear_top = 0; // last field row that needs it
+
+// The rows a line clear takes out are filled in CLEAR_FLASH, a palette entry
+// nothing else is drawn in, and that entry flashes white before the stack
+// comes down. The fills are all the drawing it takes; the flash itself is
+// just the palette entry changing, a couple of bytes a frame.
+#define CLEAR_FLASH        DARK_CYAN
+#define CLEAR_FLASH_FRAMES 12
+static uint16_t game_palette[16];
+static bool flashing = false;
+
+// Hard drops knock the canvas down and let it spring back, and clearing more
+// than one line at once shakes it, harder for each line. Neither redraws a
+// thing: the canvas is just shown somewhere else for a few frames.
+#define DROP_NUDGE_PX      2
+#define DROP_NUDGE_FRAMES  10
+#define CLEAR_SHAKE_PX     1 // per line cleared
+#define CLEAR_SHAKE_FRAMES 24
+
+// HUD items waiting for hud_task() to redraw them
+#define HUD_LEVEL  0x01
+#define HUD_SCORE  0x02
+#define HUD_PAUSED 0x04
+static uint8_t hud_dirty = 0;
+
+// shape shown in the NEXT: preview, or NO_SHAPE
+#define NO_SHAPE 0xFF
+static uint8_t preview_shape = NO_SHAPE;
+
 static bool paused = false;
 static bool game_over = false;
+static bool quit = false;
+static bool handled_key = false;
 
 // ----------------------------------------------------------------------------
+// Show a packed BCD counter, left aligned in the 4 character cells at x, y,
+// redrawing only the cells that differ from what they show already. Returns
+// false if the draw queue ran out of room, to be called again.
 // ----------------------------------------------------------------------------
-static void update_level()
+static bool update_counter(uint16_t bcd, char * cells, uint16_t x, uint16_t y)
 {
-    char str_level[10] = {0};
+    char digits[4] = {' ', ' ', ' ', ' '};
+    char str[2] = {0, 0};
+    uint8_t i, n = 0;
+
+    // most significant digit first, without leading zeros
+    for (i = 0; i < 4; i++) {
+        uint8_t d = bcd >> 12;
+        bcd <<= 4;
+        if (d != 0 || n != 0 || i == 3) {
+            digits[n++] = '0' + d;
+        }
+    }
+
     set_text_multiplier(1);
-    set_text_color(CYAN);
-    set_cursor(level_x+5*BLOCK_SIZE, level_y);
-    fill_rect(BLACK, level_x+5*BLOCK_SIZE, level_y, 4*6, 8);
-    snprintf(str_level, 10, "%u", current_level);
-    draw_string(str_level);
+    set_text_colors(CYAN, BLACK);
+    for (i = 0; i < 4; i++) {
+        if (digits[i] != cells[i]) {
+            str[0] = digits[i];
+            if (!queue_string(x + i*6, y, str)) {
+                return false;
+            }
+            cells[i] = digits[i];
+        }
+    }
+    return true;
 }
 
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
-static void update_score()
+static bool update_level()
 {
-    uint8_t new_level = current_level;
-    char str_score[10] = {0};
-    set_text_multiplier(1);
-    set_text_color(CYAN);
-    set_cursor(score_x+5*BLOCK_SIZE, score_y);
-    fill_rect(BLACK, score_x+5*BLOCK_SIZE, score_y, 4*6, 8);
-    snprintf(str_score, 10, "%u", current_score);
-    draw_string(str_score);
+    return update_counter(level_bcd, level_cells, level_x+5*BLOCK_SIZE, level_y);
+}
 
-    new_level = current_score/10;
-    if (new_level < 7 && current_level < new_level) {
-        timer_threshold = 70 - 10*new_level;
-        current_level = new_level;
-        update_level();
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+static bool update_score()
+{
+    return update_counter(score_bcd, score_cells, score_x+5*BLOCK_SIZE, score_y);
+}
+
+// ----------------------------------------------------------------------------
+// Add 0-99 points, given in BCD, to score_bcd, stopping at MAX_SCORE_BCD.
+// cc65 gets to use the 6502's decimal mode for it.
+// ----------------------------------------------------------------------------
+static void add_score(uint8_t points)
+{
+#ifdef __CC65__
+    bcd_points = points;
+    __asm__("sed");
+    __asm__("clc");
+    __asm__("lda %v", score_bcd);
+    __asm__("adc %v", bcd_points);
+    __asm__("sta %v", score_bcd);
+    __asm__("lda %v+1", score_bcd);
+    __asm__("adc #0");
+    __asm__("sta %v+1", score_bcd);
+    __asm__("lda #0");
+    __asm__("rol a");
+    __asm__("sta %v", bcd_carry);
+    __asm__("cld");
+    if (bcd_carry) {
+        score_bcd = MAX_SCORE_BCD;
+    }
+#else
+    uint16_t sum = 0;
+    uint8_t carry = 0;
+    uint8_t i;
+
+    for (i = 0; i < 16; i += 4) {
+        uint8_t d = ((score_bcd >> i) & 15) + carry;
+        if (i < 8) {
+            d += (points >> i) & 15;
+        }
+        carry = (d > 9);
+        if (carry) {
+            d -= 10;
+        }
+        sum |= (uint16_t)d << i;
+    }
+    score_bcd = carry ? MAX_SCORE_BCD : sum;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Level goes up with the score, and the HUD follows when it gets a chance.
+// ----------------------------------------------------------------------------
+static void score_changed()
+{
+    // a point in ten, so the level is the score without its last BCD digit
+    uint16_t new_level = score_bcd >> 4;
+    if (new_level > MAX_LEVEL_BCD) {
+        new_level = MAX_LEVEL_BCD;
     }
+    if (level_bcd < new_level) {
+        level_bcd = new_level;
+        current_level = (level_bcd >> 4)*10 + (level_bcd & 15);
+        hud_dirty |= HUD_LEVEL;
+    }
+    hud_dirty |= HUD_SCORE;
 }
 
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
-static void update_paused()
+static bool update_paused()
 {
     if (paused) {
         set_text_multiplier(1);
         set_text_colors(YELLOW, RED);
-        set_cursor(0, canvas_height()-8);
         if (game_over) {
-            draw_string(" !! GAME OVER !! ");
-        } else {
-            draw_string(" !!! PAUSED !!!  ");
+            return queue_string(0, canvas_height()-8, " !! GAME OVER !! ");
         }
-    } else {
-        fill_rect(BLACK, 0, canvas_height()-8, 17*6, 8);
+        return queue_string(0, canvas_height()-8, " !!! PAUSED !!!  ");
     }
+    return queue_fill_rect(BLACK, 0, canvas_height()-8, 17*6, 8);
 }
 
 // ----------------------------------------------------------------------------
@@ -240,81 +463,272 @@ static void draw_background()
 }
 
 // ----------------------------------------------------------------------------
+// Works out where each field row's stamps go, on whatever canvas the field is
+// drawn on. That has to be the one in use.
 // ----------------------------------------------------------------------------
-static void draw_shape(uint8_t shape, uint8_t rotation, uint16_t x, uint16_t y)
+static void set_field_rows()
 {
     uint8_t i;
-    for (i = 0; i < 16; i++) {
-        if (1<<i & shapes[shape].blocks[rotation]) {
-            uint8_t row = ((i>11)?1:0) + ((i>7)?1:0) + ((i>3)?1:0);
-            draw_rect(shapes[shape].color,
-                      x+(i%4)*BLOCK_SIZE,
-                      y+row*BLOCK_SIZE,
-                      BLOCK_SIZE-1,
-                      BLOCK_SIZE-1);
-        }
+    for (i = 0; i < BLOCKS_H; i++) {
+        field_rows[i] = stamp_address(FIELD_ROW_X, FIELD_ROW_Y(i));
     }
 }
 
 // ----------------------------------------------------------------------------
+// Works out where the block stamps go, once the canvas is set up.
 // ----------------------------------------------------------------------------
-static void erase_shape(uint8_t shape, uint8_t rotation, uint16_t x, uint16_t y)
+static void init_stamp_addresses()
+{
+    uint8_t i;
+
+    ON_FIELD();
+    set_field_rows();
+    for (i = 0; i < BLOCKS_W; i++) {
+        cell_cols[i] = stamp_address(i*BLOCK_SIZE, 0) - stamp_address(0, 0);
+    }
+    dot_row = stamp_address(0, BLOCK_SIZE/2 - 1) - stamp_address(0, 0);
+    ON_SCREEN();
+    for (i = 0; i < 4; i++) {
+        preview_rows[i] = stamp_address(next_x, next_y + i*BLOCK_SIZE);
+    }
+#ifdef COMPILED_SPRITES
+    use_sprites = (bits_per_pixel() == 4);
+#endif
+}
+
+// Draw queue slots a shape takes to move: 4 stamps to erase it, 4 to draw
+// it again, and the switch to the canvas it's on.
+#define SHAPE_CMDS (2*4 + 1)
+
+// ----------------------------------------------------------------------------
+// Queues a stamp for each block of a shape, with its top left corner in
+// column col of rows[0].
+// ----------------------------------------------------------------------------
+static void stamp_shape(const stamp * s, uint16_t color,
+                        uint8_t shape, uint8_t rotation,
+                        const uint16_t * rows, int8_t col)
 {
     uint8_t i;
     for (i = 0; i < 16; i++) {
         if (1<<i & shapes[shape].blocks[rotation]) {
-            uint8_t row = ((i>11)?1:0) + ((i>7)?1:0) + ((i>3)?1:0);
-            draw_rect(BLACK,
-                      x+(i%4)*BLOCK_SIZE,
-                      y+row*BLOCK_SIZE,
-                      BLOCK_SIZE-1,
-                      BLOCK_SIZE-1);
+            queue_stamp(s, color, rows[i>>2] + cell_cols[col + (i&3)]);
         }
     }
 }
 
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
-void restart_game()
+static void draw_shape(uint8_t shape, uint8_t rotation, int8_t col, int8_t row)
 {
-    uint8_t i, j;
-    // clear the screen of blocks
-    for (i = 0; i < BLOCKS_H; i++) {
-        for (j = 0;j < BLOCKS_W; j++) {
-            draw_rect(BLACK,
-                      field_x + j*BLOCK_SIZE,
-                      field_y + i*BLOCK_SIZE,
-                      BLOCK_SIZE-1,
-                      BLOCK_SIZE-1);
-            field[j][i] = 0;
+#ifdef COMPILED_SPRITES
+    if (use_sprites) { // col can be left of the field, so no cell_cols[]
+        queue_sprite(shape_sprites[shape][rotation][SPRITE_DRAW],
+                     field_rows[row] + col*(BLOCK_SIZE/2),
+                     shape_sprite_bytes[shape][rotation]);
+        return;
+    }
+#endif
+    ON_FIELD();
+    stamp_shape(&block_stamp, shapes[shape].color, shape, rotation, field_rows+row, col);
+    ON_SCREEN();
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+static void erase_shape(uint8_t shape, uint8_t rotation, int8_t col, int8_t row)
+{
+#ifdef COMPILED_SPRITES
+    if (use_sprites) {
+        queue_sprite(shape_sprites[shape][rotation][SPRITE_ERASE],
+                     field_rows[row] + col*(BLOCK_SIZE/2),
+                     shape_sprite_bytes[shape][rotation]);
+        return;
+    }
+#endif
+    ON_FIELD();
+    stamp_shape(&block_stamp, BLACK, shape, rotation, field_rows+row, col);
+    ON_SCREEN();
+}
+
+#if defined(SPRITE_BENCH) || defined(LINE_BENCH)
+#define BENCH_PHI2_HZ 8000000UL // the RP6502's default 6502 clock
+#endif
+
+#ifdef SPRITE_BENCH
+// ----------------------------------------------------------------------------
+// Times draw_shape() and erase_shape() with block stamps, then with compiled
+// sprites, over every shape and rotation, and prints the cycles per draw.
+// RIA.vsync is the only clock, so this takes a couple of seconds.
+// ----------------------------------------------------------------------------
+#define BENCH_PASSES  24
+static void sprite_bench()
+{
+    uint16_t frames[2];
+    uint16_t draws = BENCH_PASSES*SHAPE_SPRITE_SHAPES*4*2;
+    uint8_t v, pass, shape, rotation, vsync;
+
+    for (v = 0; v < 2; v++) {
+        use_sprites = (v == 1);
+        frames[v] = 0;
+        vsync = RIA.vsync;
+        while (vsync == RIA.vsync) {
+            // start on a frame edge
+        }
+        vsync = RIA.vsync;
+        for (pass = 0; pass < BENCH_PASSES; pass++) {
+            for (shape = 0; shape < SHAPE_SPRITE_SHAPES; shape++) {
+                for (rotation = 0; rotation < 4; rotation++) {
+                    // finish each, or the erase stamps supersede the draw
+                    draw_shape(shape, rotation, (BLOCKS_W/2)-2, BLOCKS_H/2);
+                    finish_draw_queue();
+                    erase_shape(shape, rotation, (BLOCKS_W/2)-2, BLOCKS_H/2);
+                    finish_draw_queue();
+                }
+            }
+            frames[v] += (uint8_t)(RIA.vsync - vsync);
+            vsync = RIA.vsync;
+        }
+    }
+    use_sprites = (bits_per_pixel() == 4);
+
+    printf("draw_shape() with stamps:  %lu cycles\n",
+           frames[0] * (BENCH_PHI2_HZ/60) / draws);
+    printf("draw_shape() with sprites: %lu cycles\n",
+           frames[1] * (BENCH_PHI2_HZ/60) / draws);
+}
+#endif
+
+#ifdef LINE_BENCH
+// ----------------------------------------------------------------------------
+// Times draw_line() in each bpp mode, over a fan of lines from the middle of
+// the canvas out to every edge (so through all eight octants, plus the axes),
+// and prints the cycles per pixel. main() sets the canvas up again after.
+// ----------------------------------------------------------------------------
+#define LINE_BENCH_GAP   4     // pixels between line ends along the edges
+#define LINE_BENCH_COLOR WHITE // one color throughout, so it's all the same work
+static uint32_t bench_line(uint16_t x1, uint16_t y1)
+{
+    uint16_t x0 = canvas_width()/2;
+    uint16_t y0 = canvas_height()/2;
+    uint16_t dx = (x1 > x0) ? x1 - x0 : x0 - x1;
+    uint16_t dy = (y1 > y0) ? y1 - y0 : y0 - y1;
+
+    draw_line(LINE_BENCH_COLOR, x0, y0, x1, y1);
+    return ((dx > dy) ? dx : dy) + 1;
+}
+
+static void line_bench()
+{
+    static const uint8_t bpps[] = {1, 2, 4, 8, 16};
+    uint32_t pixels;
+    uint16_t frames, w, h, i;
+    uint8_t m, vsync;
+
+    for (m = 0; m < sizeof(bpps); m++) {
+        init_bitmap_graphics(CANVAS_STRUCT, CANVAS_DATA, 0, 1, CANVAS_W, CANVAS_H, bpps[m]);
+        erase_canvas();
+        w = canvas_width();
+        h = canvas_height();
+        pixels = 0;
+        frames = 0;
+        vsync = RIA.vsync;
+        while (vsync == RIA.vsync) {
+            // start on a frame edge
+        }
+        vsync = RIA.vsync;
+        for (i = 0; i < w; i += LINE_BENCH_GAP) {
+            pixels += bench_line(i, 0);
+            pixels += bench_line(i, h-1);
+            frames += (uint8_t)(RIA.vsync - vsync);
+            vsync = RIA.vsync;
         }
+        for (i = 0; i < h; i += LINE_BENCH_GAP) {
+            pixels += bench_line(0, i);
+            pixels += bench_line(w-1, i);
+            frames += (uint8_t)(RIA.vsync - vsync);
+            vsync = RIA.vsync;
+        }
+        printf("draw_line() in %ubpp: %lu cycles per pixel\n", bpps[m],
+               frames * (BENCH_PHI2_HZ/60) / pixels);
     }
-    erase_shape(next_shape, 1, next_x, next_y);
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// Empties the field, on the field canvas, which has to be the one in use.
+// Rather than a BLACK stamp over every cell, it's cleared in one pass of
+// writes, and only the top row of cells is stamped, to put its grid dots
+// back. That row of dots is then copied, XRAM to XRAM, to each row below.
+// ----------------------------------------------------------------------------
+static void clear_field()
+{
+    uint8_t i;
+    // the dot row's bytes, from the first cell's start to the last one's end
+    uint16_t dots = cell_cols[BLOCKS_W-1] + cell_cols[1];
+
+    memset(field, 0, sizeof(field));
+#ifdef SURVIVAL
+    erase_canvas(); // garbage that went round to the rows off the field too
+#else
+    fill_rect(BLACK, field_x, field_y, field_w, field_h);
+#endif
+    for (i = 0; i < BLOCKS_W; i++) {
+        draw_stamp(&block_stamp, BLACK, field_rows[0] + cell_cols[i]);
+    }
+    for (i = 1; i < BLOCKS_H; i++) {
+        xram_copy(field_rows[i] + dot_row, field_rows[0] + dot_row, dots);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// ----------------------------------------------------------------------------
+void restart_game()
+{
+    // let anything still queued land first, so it can't draw over the reset
+    finish_draw_queue();
+
+    // clear the screen of blocks
+    ON_FIELD();
+#ifdef SURVIVAL
+    field_top = 0;
+    set_field_rows();
+    move_canvas(field_x, field_y);
+    rise_frames = RISE_FRAMES;
+    rising = false;
+#endif
+    clear_field();
+    ON_SCREEN();
 
     // reset state variables to starting values
-    next_shape = lrand()%7;
-    current_shape = lrand()%7;
+    bag_reset(); // each game starts on a full bag
+    next_shape = bag_next();
+    current_shape = bag_next();
     current_rotation = 1; // 90
-    current_x = field_x + (field_w/2) - 2*BLOCK_SIZE;
-    current_y = field_y;
-    timer_threshold = 60;
+    current_col = (BLOCKS_W/2) - 2;
+    current_row = 0;
+    gravity_accum = 0;
+    gravity_owed = 0;
+    lock_frames = 0;
+    clearing = false;
+    PT_INIT(&clear_pt);
+    stop_palette_anims();
+    flashing = false;
+    stop_shake();
     current_level = 1;
-    current_score = 0;
-    update_level();
-    update_score();
+    level_bcd = 0x01;
+    score_bcd = 0;
 
     // restart the game
-    draw_shape(current_shape, current_rotation, current_x, current_y);
-    draw_shape(next_shape, 1, next_x, next_y);
+    draw_shape(current_shape, current_rotation, current_col, current_row);
     paused = false;
     game_over = false;
-    update_paused();
+    hud_dirty = HUD_LEVEL | HUD_SCORE | HUD_PAUSED;
 }
 
 // ----------------------------------------------------------------------------
 // Returns true if no collision between field borders or other pieces.
 // ----------------------------------------------------------------------------
-static bool validate_move(uint8_t new_rotation, uint16_t new_x, uint16_t new_y)
+static bool validate_move(uint8_t new_rotation, int8_t new_col, int8_t new_row)
 {
     uint8_t i;
     // for each possible block in shape
@@ -323,8 +737,8 @@ static bool validate_move(uint8_t new_rotation, uint16_t new_x, uint16_t new_y)
             // OK, we have to test this block against field
             uint8_t col = i%4;
             uint8_t row = ((i>11)?1:0) + ((i>7)?1:0) + ((i>3)?1:0);
-            int16_t field_col = col + ((int16_t)new_x-field_x)/BLOCK_SIZE;
-            int16_t field_row = row + ((int16_t)new_y-field_y)/BLOCK_SIZE;
+            int8_t field_col = new_col + col;
+            int8_t field_row = new_row + row;
             if ((field_col < 0) ||                  // collision with field left border
                 (field_col > (BLOCKS_W-1)) ||       // collision with field right border
                 (field_row < 0) ||                  // collision with field top border
@@ -342,27 +756,54 @@ static bool validate_move(uint8_t new_rotation, uint16_t new_x, uint16_t new_y)
 // If allowed, erases shape in old position and redraws it in new position.
 // Returns true if validation succeeded, else false.
 // ----------------------------------------------------------------------------
-static bool move_shape(move_axis axis, uint8_t new_rotation, uint16_t new_x, uint16_t new_y)
+static bool move_shape(move_axis axis, uint8_t new_rotation, int8_t new_col, int8_t new_row)
 {
-    if (validate_move(new_rotation, new_x, new_y)) {
-        erase_shape(current_shape, current_rotation, current_x, current_y);
+    if (validate_move(new_rotation, new_col, new_row)) {
+        erase_shape(current_shape, current_rotation, current_col, current_row);
         switch (axis) {
             case AXIS_X:
-                current_x = new_x;
+                current_col = new_col;
                 break;
             case AXIS_Y:
-                current_y = new_y;
+                current_row = new_row;
                 break;
             case AXIS_Z:
                 current_rotation = new_rotation;
                 break;
         }
-        draw_shape(current_shape, current_rotation, current_x, current_y);
+        draw_shape(current_shape, current_rotation, current_col, current_row);
         return true;
     }
     return false;
 }
 
+// ----------------------------------------------------------------------------
+// Returns how many rows (up to max_rows) current_shape can fall before landing.
+// Only the field array is tested, so nothing is drawn for the rows skipped.
+// ----------------------------------------------------------------------------
+static uint8_t drop_distance(uint8_t max_rows)
+{
+    uint8_t rows = 0;
+    while (rows < max_rows &&
+           validate_move(current_rotation, current_col, current_row+rows+1)) {
+        rows++;
+    }
+    return rows;
+}
+
+// ----------------------------------------------------------------------------
+// Moves current_shape straight down by up to max_rows rows, erasing and
+// redrawing it only once. Returns the number of rows it actually fell.
+// ----------------------------------------------------------------------------
+static uint8_t drop_shape(uint8_t max_rows)
+{
+    uint8_t rows = drop_distance(max_rows);
+    if (rows > 0) {
+        move_shape(AXIS_Y, current_rotation, current_col, current_row+rows);
+    }
+    return rows;
+}
+
 // ----------------------------------------------------------------------------
 // Update the field array with color and position of new shape
 // ----------------------------------------------------------------------------
@@ -375,122 +816,460 @@ static void save_shape_to_field()
             // OK, block is not 0 (black)
             uint8_t col = i%4;
             uint8_t row = ((i>11)?1:0) + ((i>7)?1:0) + ((i>3)?1:0);
-            int16_t field_col = col + ((int16_t)current_x-field_x)/BLOCK_SIZE;
-            int16_t field_row = row + ((int16_t)current_y-field_y)/BLOCK_SIZE;
+            int8_t field_col = current_col + col;
+            int8_t field_row = current_row + row;
             field[field_col][field_row] = shapes[current_shape].color;
         }
     }
 }
 
 // ----------------------------------------------------------------------------
-// Recursively called to copy all non-empty rows down one row.
+// Copies field row src down into field row dst (field array only).
 // ----------------------------------------------------------------------------
-static void copy_row_above(uint8_t row)
+static void copy_row_above(uint8_t dst, uint8_t src)
 {
-    if (row > 0) {
-        uint8_t col;
-        bool row_above_not_blank = false;
-        for (col = 0; col < BLOCKS_W; col++) {
-            if (!row_above_not_blank && field[col][row-1] != 0) {
-                row_above_not_blank = true;
-            }
-            field[col][row] = field[col][row-1];
-            draw_rect(field[col][row],
-                      field_x + col*BLOCK_SIZE,
-                      field_y + row*BLOCK_SIZE,
-                      BLOCK_SIZE-1,
-                      BLOCK_SIZE-1);
-        }
-        if (row_above_not_blank) {
-            copy_row_above(row-1); // recurse
-        }
+    uint8_t col;
+    for (col = 0; col < BLOCKS_W; col++) {
+        field[col][dst] = field[col][src];
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Redraws every block of one field row from the field array.
+// ----------------------------------------------------------------------------
+static void draw_field_row(uint8_t row)
+{
+    uint8_t col;
+    ON_FIELD();
+    for (col = 0; col < BLOCKS_W; col++) {
+        queue_stamp(&block_stamp, field[col][row], field_rows[row] + cell_cols[col]);
     }
+    ON_SCREEN();
 }
 
 // ----------------------------------------------------------------------------
-// Looks for completely filled 'scoring' rows.
-// Recursively called for all non-empty rows,
+// Looks for completely filled 'scoring' rows, bottom up, and squeezes them
+// out of the field array. The scoring rows are only filled in CLEAR_FLASH
+// here; the rows that changed are left in clear_row..clear_top for
+// clear_task() to redraw.
 // Note that finding more than one scoring row results in scoring bonus!
 // ----------------------------------------------------------------------------
-static void check_for_scoring_row(uint8_t row, uint8_t *p_num_scoring_rows)
+static uint8_t check_for_scoring_rows()
 {
+    uint8_t num_scoring_rows = 0;
+    int8_t dst = BLOCKS_H-1;
+    int8_t row;
     uint8_t col;
-    if (row > 0) {
+
+    ON_FIELD();
+    for (row = BLOCKS_H-1; row >= 0; row--) {
         bool scoring_row = true;
-        bool row_above_not_blank = false;
+        bool blank_row = true;
         for (col = 0; col < BLOCKS_W; col++) {
             if (field[col][row] == 0) {
                 scoring_row = false;
-            } else if (!row_above_not_blank) {
-                row_above_not_blank = true;
+            } else {
+                blank_row = false;
             }
         }
+        if (blank_row) {
+            break; // nothing above here can have moved
+        }
         if (scoring_row) {
-            *p_num_scoring_rows += 1;
-            current_score += *p_num_scoring_rows; // +1, +2, +3, ...
-            copy_row_above(row); // recursive routine results in all rows above moving down
+            if (num_scoring_rows == 0) {
+                clear_row = row; // lowest row that changes
+            }
+            if (!queue_fill_rect(CLEAR_FLASH, FIELD_ROW_X, FIELD_ROW_Y(row),
+                                 field_w, BLOCK_SIZE)) {
+                // no room, so fill it now: anything still queued for the
+                // row can only mark the flash, and clear_task() redraws it
+                fill_rect(CLEAR_FLASH, FIELD_ROW_X, FIELD_ROW_Y(row),
+                          field_w, BLOCK_SIZE);
+            }
+            num_scoring_rows += 1;
+            add_score(num_scoring_rows); // +1, +2, +3, ...
+        } else {
+            if (dst != row) {
+                copy_row_above(dst, row);
+            }
+            dst--;
         }
-        if (row_above_not_blank) {
-            // if scoring row, it is now gone, so we need to test the same row again
-            check_for_scoring_row(row - (scoring_row?0:1), p_num_scoring_rows); // recurse
+    }
+    // the stack came down, so blank out what it left behind
+    for (; dst > row; dst--) {
+        for (col = 0; col < BLOCKS_W; col++) {
+            field[col][dst] = 0;
         }
     }
+    clear_top = row+1;
+    ON_SCREEN();
+    return num_scoring_rows;
 }
 
 // ----------------------------------------------------------------------------
-// Kicks off recursive scoring check, and recursive scoring row removal
 // ----------------------------------------------------------------------------
-static void check_for_scoring_rows()
+static void end_game()
 {
-    uint8_t num_scoring_rows = 0;
-    check_for_scoring_row(BLOCKS_H-1, &num_scoring_rows);
-    update_score();
+    paused = true;
+    game_over = true;
+    hud_dirty |= HUD_PAUSED;
 }
 
+// ----------------------------------------------------------------------------
+// Try to add a new shape at top, or end the game if there's no room for it.
+// ----------------------------------------------------------------------------
+static void spawn_shape()
+{
+    current_shape = next_shape;
+    next_shape = bag_next();
+    current_rotation = 1; // 90
+    current_col = (BLOCKS_W/2) - 2;
+    current_row = 0;
+    lock_frames = 0;
+    if (validate_move(current_rotation, current_col, current_row)) {
+        draw_shape(current_shape, current_rotation, current_col, current_row);
+    } else { // can't add new shape at top either, so...game over!
+        end_game();
+    }
+}
+
+#ifdef SURVIVAL
+// Draw queue slots a garbage row takes: the shape moving, the switch to the
+// field canvas, clearing the row going off the top and a stamp per column.
+#define RISE_CMDS (SHAPE_CMDS + 2 + BLOCKS_W)
+
+// ----------------------------------------------------------------------------
+// Pushes the stack up a row with a row of garbage. The field canvas is to be
+// shown a row higher, so only the new bottom row is drawn, in the cell row
+// that was below the field; the row pushed off the top is cleared, to come
+// round as the next one. It's all queued, and render_task() moves the canvas
+// once it's drawn. The shape stays put unless the stack comes up into it.
+// Returns false, and does nothing, if the queue hasn't room for all that.
+// ----------------------------------------------------------------------------
+static bool rise_garbage()
+{
+    uint8_t col;
+    uint8_t hole;
+    uint8_t gone = field_top; // cell row going off the top
+
+    if (draw_queue_room() < RISE_CMDS) {
+        return false;
+    }
+    for (col = 0; col < BLOCKS_W; col++) {
+        if (field[col][0] != 0) { // nowhere left for the stack to go
+            end_game();
+            return true;
+        }
+    }
+
+    // queued draws have XRAM addresses, so this lands where it was meant to
+    erase_shape(current_shape, current_rotation, current_col, current_row);
+
+    hole = rng_below(BLOCKS_W);
+    for (col = 0; col < BLOCKS_W; col++) {
+        memmove(&field[col][0], &field[col][1], (BLOCKS_H-1)*sizeof(field[0][0]));
+        field[col][BLOCKS_H-1] = (col == hole) ? 0 : GARBAGE_COLOR;
+    }
+
+    ON_FIELD();
+    field_top = (field_top + 1) % FIELD_ROWS;
+    set_field_rows();
+    queue_fill_rect(BLACK, 0, gone*BLOCK_SIZE, field_w, BLOCK_SIZE);
+    ON_SCREEN();
+    draw_field_row(BLOCKS_H-1);
+    rising = true;
+
+    if (!validate_move(current_rotation, current_col, current_row)) {
+        if (!validate_move(current_rotation, current_col, current_row-1)) {
+            end_game();
+            return true;
+        }
+        current_row--;
+    }
+    draw_shape(current_shape, current_rotation, current_col, current_row);
+    return true;
+}
+#endif
+
 // ----------------------------------------------------------------------------
 // Deal with the consequences of a dropped shape
 // ----------------------------------------------------------------------------
 static void process_drop()
 {
+    uint8_t lines;
+
     // Shape has dropped as far as possible,
     // so update field and see if we scored
     save_shape_to_field();
-    check_for_scoring_rows();
+    lines = check_for_scoring_rows();
+    rows_moved = (lines > 0);
+    if (rows_moved) {
+        score_changed();
+        flash_palette(CLEAR_FLASH, color(WHITE, true), CLEAR_FLASH_FRAMES);
+        flashing = true;
+    }
+#ifndef SURVIVAL // the field's on another plane, which would stay put
+    if (lines > 1) {
+        shake_canvas(lines*CLEAR_SHAKE_PX, 0, CLEAR_SHAKE_FRAMES);
+    }
+#endif
 
-    // Try to add a new shape at top
-    erase_shape(next_shape, 1, next_x, next_y);
-    current_shape = next_shape;
-    next_shape = lrand()%7;
-    current_rotation = 1; // 90
-    current_x = field_x + (field_w/2) - 2*BLOCK_SIZE;
-    current_y = field_y;
-    if (validate_move(current_rotation, current_x, current_y)) {
-        draw_shape(next_shape, 1, next_x, next_y);
-        draw_shape(current_shape, current_rotation, current_x, current_y);
-    } else { // can't add new shape at top either, so...game over!
-        paused = true;
-        game_over = true;
-        update_paused();
+    // clear_task() does the redraw and brings in the next shape
+    clearing = true;
+}
+
+// ----------------------------------------------------------------------------
+// Draws what the other tasks queued last frame, right after the vsync edge,
+// and shows the field a row higher once a garbage row is all drawn.
+// ----------------------------------------------------------------------------
+static uint8_t render_task()
+{
+    flashing = animate_palette();
+    animate_shake();
+    flush_draw_queue();
+#ifdef SURVIVAL
+    if (rising && draw_queue_length() == 0) {
+        ON_FIELD();
+        move_canvas(field_x, field_y - field_top*BLOCK_SIZE);
+        ON_SCREEN();
+        rising = false;
     }
+#endif
+    return TASK_IDLE;
 }
 
+// ----------------------------------------------------------------------------
+// Copies the keyboard bitmask from XRAM into keystates[].
+// Uses portal 1, since bitmap_graphics keeps track of portal 0.
+// ----------------------------------------------------------------------------
+static uint8_t input_task()
+{
+    uint8_t i;
+    RIA.addr1 = KEYBOARD_INPUT;
+    RIA.step1 = 1;
+    for (i = 0; i < KEYBOARD_BYTES; i++) {
+        keystates[i] = RIA.rw1;
+    }
+    return TASK_IDLE;
+}
+
+// ----------------------------------------------------------------------------
+// Gravity and keystrokes.
+// ----------------------------------------------------------------------------
+static uint8_t game_task()
+{
+    // The shape can only be moved when there is one in play and no garbage
+    // row is waiting to be shown. Each move also needs SHAPE_CMDS free in the
+    // draw queue; gravity without them is owed to a later frame, and a move
+    // key is left down until there's room for it.
+    bool playing = !paused && !clearing && !RISING();
+    bool held;
+
+    // Apply gravity for every frame that went by, and drop current_shape
+    // by the whole rows accumulated, straight to its landing row if need be.
+    if (playing && draw_queue_room() < SHAPE_CMDS) {
+        gravity_owed += tasks_elapsed();
+        if (gravity_owed > 4 || gravity_owed < tasks_elapsed()) {
+            gravity_owed = 4;
+        }
+    } else if (playing) {
+        uint8_t frames = tasks_elapsed() + gravity_owed;
+        uint8_t rows;
+        if (frames > 4 || frames < gravity_owed) {
+            frames = 4; // don't fling the shape down after a long stall
+        }
+        gravity_owed = 0;
+        if (gravity_table[current_level] >= GRAVITY_20G) {
+            gravity_accum = 0;
+            rows = BLOCKS_H; // all the way to the floor, every frame
+        } else {
+            gravity_accum += frames*gravity_table[current_level];
+            rows = gravity_accum >> 8;
+            gravity_accum &= (GRAVITY_1G-1);
+        }
+        if (lock_frames < LOCK_DELAY) {
+            lock_frames += frames;
+        }
+        if (rows > 0) {
+            if (drop_shape(rows) > 0) {
+                lock_frames = 0;
+            } else if (lock_frames >= LOCK_DELAY) {
+                process_drop();
+                playing = false;
+            }
+        }
+#ifdef SURVIVAL
+        if (playing && rise_frames <= frames) {
+            if (rise_garbage()) { // or the queue's too full, so next frame
+                rise_frames = RISE_FRAMES - current_level*RISE_PER_LEVEL;
+                playing = false;
+            }
+        } else if (playing) {
+            rise_frames -= frames;
+        }
+#endif
+    }
+
+    // check for a key down
+    held = playing && draw_queue_room() < SHAPE_CMDS &&
+           (key(KEY_RIGHT) || key(KEY_LEFT) || key(KEY_UP) || key(KEY_DOWN));
+    if (!(keystates[0] & 1)) {
+        if (!handled_key && !held) { // handle only once per single keypress
+            // handle the keystrokes
+            if (playing && key(KEY_RIGHT)) { // try to move shape right
+                move_shape(AXIS_X, current_rotation, current_col+1, current_row);
+            } else if (playing && key(KEY_LEFT)) { // try to move shape left
+                move_shape(AXIS_X, current_rotation, current_col-1, current_row);
+            } else if (playing && key(KEY_UP)) { // try to rotate shape
+                move_shape(AXIS_Z, (current_rotation+1)%4, current_col, current_row);
+            } else if (playing && key(KEY_DOWN)) { // drop the shape as far as possible
+#ifdef SURVIVAL
+                drop_shape(BLOCKS_H);
+#else
+                if (drop_shape(BLOCKS_H) > 0) {
+                    nudge_canvas(0, DROP_NUDGE_PX, DROP_NUDGE_FRAMES);
+                }
+#endif
+                process_drop();
+            }  else if (key(KEY_P)) { // pause
+                paused = !paused;
+                hud_dirty |= HUD_PAUSED;
+            } else if (key(KEY_R)) { // restart game
+                restart_game();
+            } else if (key(KEY_ESC)) { // exit game
+                quit = true;
+            }
+            handled_key = true;
+        }
+    } else { // no keys down
+        handled_key = false;
+    }
+    return TASK_IDLE;
+}
+
+// ----------------------------------------------------------------------------
+// Once the flash is over, redraws the rows a line clear moved, one row per
+// slice, then brings in the next shape.
+// ----------------------------------------------------------------------------
+static uint8_t clear_task()
+{
+    PT_BEGIN(&clear_pt);
+    PT_WAIT_UNTIL(&clear_pt, clearing && !paused);
+    if (rows_moved) {
+        PT_WAIT_UNTIL(&clear_pt, !flashing);
+        for (;;) {
+            // don't outrun render_task(), or the row won't all fit in the queue
+            PT_WAIT_UNTIL(&clear_pt, draw_queue_room() > BLOCKS_W);
+            draw_field_row(clear_row);
+            if (clear_row == clear_top) {
+                break;
+            }
+            clear_row--;
+            PT_YIELD(&clear_pt);
+            PT_WAIT_UNTIL(&clear_pt, !paused);
+        }
+        PT_YIELD(&clear_pt);
+    }
+    PT_WAIT_UNTIL(&clear_pt, draw_queue_room() >= SHAPE_CMDS);
+    clearing = false;
+    spawn_shape();
+    PT_END(&clear_pt);
+}
+
+// ----------------------------------------------------------------------------
+// Redraws whatever changed on the HUD, one item per slice.
+// ----------------------------------------------------------------------------
+static uint8_t hud_task()
+{
+    uint8_t item;
+    bool queued;
+
+    if (hud_dirty & HUD_LEVEL) {
+        item = HUD_LEVEL;
+        queued = update_level();
+    } else if (hud_dirty & HUD_SCORE) {
+        item = HUD_SCORE;
+        queued = update_score();
+    } else if (hud_dirty & HUD_PAUSED) {
+        item = HUD_PAUSED;
+        queued = update_paused();
+    } else {
+        return TASK_IDLE;
+    }
+    if (!queued) {
+        return TASK_IDLE; // the queue's full, so carry on next frame
+    }
+    hud_dirty &= ~item;
+    return TASK_BUSY;
+}
+
+// ----------------------------------------------------------------------------
+// Keeps the NEXT: preview in step with next_shape.
+// ----------------------------------------------------------------------------
+static uint8_t preview_task()
+{
+    if (preview_shape == next_shape || draw_queue_room() < SHAPE_CMDS) {
+        return TASK_IDLE;
+    }
+    if (preview_shape != NO_SHAPE) {
+        stamp_shape(&preview_stamp, BLACK, preview_shape, 1, preview_rows, 0);
+    }
+    preview_shape = next_shape;
+    stamp_shape(&preview_stamp, shapes[preview_shape].color, preview_shape, 1, preview_rows, 0);
+    return TASK_IDLE;
+}
+
+// Highest priority first. Rendering goes first to catch the vsync edge.
+// HUD and preview make way for input and gravity when a frame runs late;
+// a sound task would be deferrable too.
+static task game_tasks[] = {
+    {render_task,  1, 0},
+    {input_task,   1, 0},
+    {game_task,    1, 0},
+    {clear_task,   CLEAR_ROWS_PER_TICK, 0},
+    {hud_task,     3, TASK_DEFERRABLE},
+    {preview_task, 1, TASK_DEFERRABLE}
+};
+#define NUM_GAME_TASKS (sizeof(game_tasks)/sizeof(game_tasks[0]))
+
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 int main()
 {
-    uint8_t v; // vsync counter, incements every 1/60 second, rolls over every 256
-    uint16_t timer = 0; // counts longer before rolling over, and we can reset it
-    bool handled_key = false;
+    uint8_t i;
 
+#ifdef LINE_BENCH
+    line_bench();
+#endif
     // plane=0, canvas=1, w=320, h=240, bpp4
 #if (CANVAS_H == 180)
-    init_bitmap_graphics(0xFF00, 0x0000, 0, 2, CANVAS_W, CANVAS_H, 4);
+    init_bitmap_graphics(CANVAS_STRUCT, CANVAS_DATA, 0, 2, CANVAS_W, CANVAS_H, 4);
 #else
-    init_bitmap_graphics(0xFF00, 0x0000, 0, 1, CANVAS_W, CANVAS_H, 4);
+    init_bitmap_graphics(CANVAS_STRUCT, CANVAS_DATA, 0, 1, CANVAS_W, CANVAS_H, 4);
 #endif
 
+    // The built-in colors, but for CLEAR_FLASH, which starts out black
+    for (i = 0; i < 16; i++) {
+        game_palette[i] = color(i, true);
+    }
+    game_palette[CLEAR_FLASH] = color(BLACK, true);
+    set_palette(GAME_PALETTE, game_palette, 16);
+
     // Erase display
     erase_canvas();
+#ifdef SURVIVAL
+    screen_canvas = current_canvas();
+    init_bitmap_plane(&field_canvas, FIELD_STRUCT, FIELD_DATA, 1, field_x, field_y,
+                      field_w, CANVAS_H, 4);
+    use_palette(GAME_PALETTE);
+    set_canvas_wrap(false, true);
+    erase_canvas();
+    use_canvas(screen_canvas);
+#endif
+    init_stamp_addresses();
+#ifdef SPRITE_BENCH
+    sprite_bench();
+#endif
     //printf("\f"); // clear console
 
     //xreg_vga_mode(0, 1); // console
@@ -498,83 +1277,23 @@ int main()
     printf("Hello, from Tetricks!\n");
 
     draw_background();
+#ifdef RNG_SEED
+    rng_seed(RNG_SEED); // the same games every run
+#else
+    rng_seed((uint16_t)lrand());
+#endif
     restart_game();
 
-    // initialize keyboard
-    xregn( 0, 0, 0, 1, KEYBOARD_INPUT);
-    RIA.addr0 = KEYBOARD_INPUT;
-    RIA.step0 = 0;
+    // initialize keyboard (xram_map.h addresses are long, and this is varargs)
+    xreg_ria_keyboard((uint16_t)KEYBOARD_INPUT);
 
     // vsync loop
-    v = RIA.vsync;
-    while (1) {
-        uint8_t i;
-
-        // we will use the RIA.vsync counter for our drop timer
-        if (v == RIA.vsync) {
-            continue; // wait until vsync is incremented
-        } else {
-            v = RIA.vsync; // new value for v
-        }
-        timer++; // use this instead of v, because we can reset this
-
-        // Try to drop current_shape one row every time timer exceeds timer_threshold
-        if (!paused && timer > timer_threshold) {
-            timer = 0; // reset it
-
-            // drop the current_shape if possible
-            if (!move_shape(AXIS_Y, current_rotation, current_x, current_y+BLOCK_SIZE)) {
-                process_drop();
-            }
-        }
-
-        // fill the keystates bitmask array
-        for (i = 0; i < KEYBOARD_BYTES; i++) {
-            uint8_t new_keys;
-            RIA.addr0 = KEYBOARD_INPUT + i;
-            new_keys = RIA.rw0;
-/*
-            // check for change in any and all keys
-            {
-                uint8_t j;
-                for (j = 0; j < 8; j++) {
-                    uint8_t new_key = (new_keys & (1<<j));
-                    if ((((i<<3)+j)>3) && (new_key != (keystates[i] & (1<<j)))) {
-                        printf( "key %d %s\n", ((i<<3)+j), (new_key ? "pressed" : "released"));
-                    }
-                }
-            }
-*/
-            keystates[i] = new_keys;
-        }
-
-        // check for a key down
-        if (!(keystates[0] & 1)) {
-            if (!handled_key) { // handle only once per single keypress
-                // handle the keystrokes
-                if (!paused && key(KEY_RIGHT)) { // try to move shape right
-                    move_shape(AXIS_X, current_rotation, current_x+BLOCK_SIZE, current_y);
-                } else if (!paused && key(KEY_LEFT)) { // try to move shape left
-                    move_shape(AXIS_X, current_rotation, current_x-BLOCK_SIZE, current_y);
-                } else if (!paused && key(KEY_UP)) { // try to rotate shape
-                    move_shape(AXIS_Z, (current_rotation+1)%4, current_x, current_y);
-                } else if (!paused && key(KEY_DOWN)) { // drop the shape as far as possible
-                    while(move_shape(AXIS_Y, current_rotation, current_x, current_y+BLOCK_SIZE)){;}
-                    process_drop();
-                }  else if (key(KEY_P)) { // pause
-                    paused = !paused;
-                    update_paused();
-                } else if (key(KEY_R)) { // restart game
-                    restart_game();
-                } else if (key(KEY_ESC)) { // exit game
-                    break;
-                }
-                handled_key = true;
-            }
-        } else { // no keys down
-            handled_key = false;
-        }
+    tasks_init();
+    while (!quit) {
+        tasks_wait_vsync();
+        tasks_run(game_tasks, NUM_GAME_TASKS);
     }
     //exit
+    printf("Worst frame took %u vsyncs\n", tasks_worst_frames());
     printf("Goodbye!\n");
 }
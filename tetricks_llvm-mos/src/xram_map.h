@@ -0,0 +1,80 @@
+// ---------------------------------------------------------------------------
+// xram_map.h
+//
+// Where tetricks keeps everything in the 64K of XRAM. Pixel data is packed
+// up from 0x0000, and the small things (mode structs, the palette, the
+// keyboard bitmask) down against the top, so the headroom is all in one
+// piece in the middle.
+// Each address here follows from the one next to it and a size, going up
+// from the bottom or down from the top, which makes this header the
+// allocator: nothing is worked out at run time.
+//
+// XRAM_MAP lists every region as X(name, address, bytes), for the check at
+// the bottom, which stops the build if the two ends meet, and for
+// tools/xram_map.py, which prints the map after each build. A new region
+// goes in both places. Keep to plain integer arithmetic here, so the
+// preprocessor and the tool can both work it out.
+// ---------------------------------------------------------------------------
+
+#ifndef XRAM_MAP_H
+#define XRAM_MAP_H
+
+#define XRAM_TOP 0x10000L
+
+// The screen: one 4bpp canvas on plane 0
+#define CANVAS_W     320
+#define CANVAS_H     240 // 180 or 240
+#define CANVAS_BYTES (CANVAS_W/2L*CANVAS_H)
+
+#define MODE3_CONFIG_BYTES 14 // sizeof(vga_mode3_config_t)
+#define PALETTE_BYTES      32 // 16 rgb5 colors, which 4bpp needs
+#define KEYBOARD_BYTES     32 // a bit for each of 256 HID codes
+
+// Survival puts the field on a 4bpp canvas of its own on plane 1, as wide as
+// the field (tetricks.c checks that) and as tall as the screen.
+#ifdef SURVIVAL
+#define FIELD_CANVAS_W      96
+#define FIELD_BYTES         (FIELD_CANVAS_W/2L*CANVAS_H)
+#define FIELD_STRUCT_BYTES  MODE3_CONFIG_BYTES
+#else
+#define FIELD_BYTES         0
+#define FIELD_STRUCT_BYTES  0
+#endif
+
+// Pixel data, going up
+#define CANVAS_DATA    0x0000L
+#define FIELD_DATA     (CANVAS_DATA + CANVAS_BYTES)
+#define XRAM_LOW_END   (FIELD_DATA + FIELD_BYTES)
+
+// Structs and input, going down
+#define KEYBOARD_INPUT  (XRAM_TOP - KEYBOARD_BYTES)
+#define GAME_PALETTE    (KEYBOARD_INPUT - PALETTE_BYTES)
+#define CANVAS_STRUCT   (GAME_PALETTE - MODE3_CONFIG_BYTES)
+#define FIELD_STRUCT    (CANVAS_STRUCT - FIELD_STRUCT_BYTES)
+
+// Regions that aren't in this build are 0 bytes, wherever they'd be.
+#define XRAM_MAP(X)                                         \
+    X(CANVAS_DATA,    CANVAS_DATA,    CANVAS_BYTES)         \
+    X(FIELD_DATA,     FIELD_DATA,     FIELD_BYTES)          \
+    X(FIELD_STRUCT,   FIELD_STRUCT,   FIELD_STRUCT_BYTES)   \
+    X(CANVAS_STRUCT,  CANVAS_STRUCT,  MODE3_CONFIG_BYTES)   \
+    X(GAME_PALETTE,   GAME_PALETTE,   PALETTE_BYTES)        \
+    X(KEYBOARD_INPUT, KEYBOARD_INPUT, KEYBOARD_BYTES)
+
+#define XRAM_HIGH_START FIELD_STRUCT // the lowest of those going down
+#define XRAM_HEADROOM   (XRAM_HIGH_START - XRAM_LOW_END)
+
+#if (XRAM_LOW_END > XRAM_HIGH_START)
+    #error "The canvases don't fit in XRAM under the structs and input"
+#endif
+
+// The line benchmark sets the screen up again in every bpp, using the pixel
+// data from CANVAS_DATA on, before anything else is in XRAM, but it still
+// has to leave the structs alone. 16bpp is 240x124.
+#ifdef LINE_BENCH
+#if (CANVAS_DATA + 240*2L*124 > XRAM_HIGH_START)
+    #error "The line benchmark's 16bpp canvas runs into the XRAM structs"
+#endif
+#endif
+
+#endif // XRAM_MAP_H
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+#
+# Transpose the column-major 5x7 font in font5x7.h into row-major glyphs.
+#
+# font5x7.h stores each glyph as 5 column bytes, bit 0 at the top. Drawing a
+# glyph a scanline at a time wants it the other way around, so this writes
+# 8 row bytes per glyph instead, column 0 in bit 7 and columns 5-7 clear.
+#
+# With --chars and/or --scan only the glyphs those need are kept, where
+# --scan reads the string literals passed to draw_string() and queue_string().
+# font_index then maps each char from FONT_ROWS_FIRST to FONT_ROWS_LAST to its
+# glyph in font_rows. Glyph 0 is always blank, and stands in for anything left
+# out.
+
+import re
+import argparse
+
+ESCAPES = {"n": "\n", "t": "\t", "r": "\r", "0": "\0", "a": "\a", "b": "\b",
+           "f": "\f", "v": "\v", "\\": "\\", "'": "'", '"': '"', "?": "?"}
+
+# the calls whose string literals get drawn, and so need glyphs
+DRAW_CALLS = ("draw_string", "queue_string")
+
+
+def read_font(path):
+    """Returns the glyph column bytes from the font[] array in a C header."""
+    with open(path) as f:
+        text = f.read()
+    body = re.search(r"font\[\]\s*=\s*\{(.*?)\};", text, re.S).group(1)
+    body = re.sub(r"//[^\n]*|/\*.*?\*/", "", body, flags=re.S)
+    return [int(v, 0) for v in re.findall(r"0[xX][0-9a-fA-F]+|\d+", body)]
+
+
+def unescape(literal):
+    """Returns the chars of a C string literal body."""
+    out = ""
+    i = 0
+    while i < len(literal):
+        c = literal[i]
+        i += 1
+        if c != "\\":
+            out += c
+            continue
+        c = literal[i]
+        i += 1
+        if c == "x":
+            digits = re.match(r"[0-9a-fA-F]+", literal[i:]).group(0)
+            out += chr(int(digits, 16) & 0xFF)
+            i += len(digits)
+        elif c in "01234567":
+            digits = re.match(r"[0-7]{1,3}", literal[i - 1:]).group(0)
+            out += chr(int(digits, 8) & 0xFF)
+            i += len(digits) - 1
+        else:
+            out += ESCAPES.get(c, c)
+    return out
+
+
+def call_args(text, start):
+    """Returns the text from start up to the paren that closes a call."""
+    depth = 1
+    i = start
+    while i < len(text) and depth > 0:
+        literal = re.match(r'"(?:[^"\\\n]|\\.)*"|\'(?:[^\'\\\n]|\\.)*\'', text[i:])
+        if literal:
+            i += len(literal.group(0))
+            continue
+        depth += {"(": 1, ")": -1}.get(text[i], 0)
+        i += 1
+    return text[start:i - 1]
+
+
+def scan_strings(path):
+    """Returns the chars of the string literals a C source file draws."""
+    with open(path) as f:
+        text = f.read()
+    text = re.sub(r"//[^\n]*|/\*.*?\*/", "", text, flags=re.S)
+    chars = set()
+    for call in re.finditer(r"\b(?:%s)\s*\(" % "|".join(DRAW_CALLS), text):
+        args = call_args(text, call.end())
+        for literal in re.findall(r'"((?:[^"\\\n]|\\.)*)"', args):
+            chars.update(unescape(literal))
+    return chars
+
+
+def transpose(columns):
+    """Returns the 8 row bytes for one glyph's 5 column bytes."""
+    rows = []
+    for j in range(8):
+        row = 0
+        for i, col in enumerate(columns):
+            if col & (1 << j):
+                row |= 0x80 >> i
+        rows.append(row)
+    return rows
+
+
+def glyph_comment(code):
+    return repr(chr(code)) if 32 <= code <= 126 else "0x%02X" % code
+
+
+def write_header(path, source, glyphs, codes, first, index):
+    with open(path, "w") as f:
+        f.write("// Generated by tools/font5x7.py from %s -- do not edit.\n" % source)
+        f.write("//\n// 8 row bytes per glyph, top row first, column 0 in bit 7.\n")
+        f.write("// font_index maps chars FONT_ROWS_FIRST to FONT_ROWS_LAST to glyphs.\n\n")
+        f.write("#ifndef FONT5X7_ROWS_H\n#define FONT5X7_ROWS_H\n\n")
+        f.write("#define FONT_ROWS_GLYPHS %d\n" % len(glyphs))
+        f.write("#define FONT_ROWS_FIRST  %d\n" % first)
+        f.write("#define FONT_ROWS_LAST   %d\n\n" % (first + len(index) - 1))
+        f.write("static const unsigned char font_index[] = {\n")
+        for i in range(0, len(index), 16):
+            f.write("    %s,\n" % ", ".join("%3d" % g for g in index[i:i + 16]))
+        f.write("};\n\n")
+        f.write("static const unsigned char font_rows[] = {\n")
+        for code, rows in zip(codes, glyphs):
+            f.write("    %s, // %s\n" % (", ".join("0x%02X" % r for r in rows),
+                                        "blank" if code is None
+                                        else glyph_comment(code)))
+        f.write("};\n\n#endif // FONT5X7_ROWS_H\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("font", help="font5x7.h to read")
+    parser.add_argument("-o", "--out", required=True, help="header to write")
+    parser.add_argument("-c", "--chars", default=None,
+                        help="chars to keep glyphs for")
+    parser.add_argument("-s", "--scan", nargs="*", default=[],
+                        help="C sources whose drawn strings need glyphs")
+    args = parser.parse_args()
+
+    data = read_font(args.font)
+    if len(data) % 5:
+        parser.error("font has %d bytes, not a multiple of 5" % len(data))
+    font = [transpose(data[i:i + 5]) for i in range(0, len(data), 5)]
+    # so any char can index it, missing glyphs at the end are blank
+    font += [[0] * 8] * (256 - len(font))
+
+    if args.chars is None and not args.scan:
+        wanted = set(range(256))
+    else:
+        chars = set(args.chars or "")
+        for path in args.scan:
+            chars |= scan_strings(path)
+        wanted = set(ord(c) & 0xFF for c in chars)
+        # control chars are handled by the text cursor, not drawn
+        wanted = set(c for c in wanted if c >= 32 and any(font[c]))
+    if not wanted:
+        wanted = {32}
+
+    # glyph 0 is blank, then one glyph per distinct bitmap wanted
+    glyphs = [[0] * 8]
+    codes = [None]
+    first = min(wanted)
+    index = []
+    for code in range(first, max(wanted) + 1):
+        if code not in wanted or not any(font[code]):
+            index.append(0)
+            continue
+        if font[code] not in glyphs:
+            glyphs.append(font[code])
+            codes.append(code)
+        index.append(glyphs.index(font[code]))
+    write_header(args.out, "font5x7.h", glyphs, codes, first, index)
+
+
+if __name__ == "__main__":
+    main()